@@ -0,0 +1,189 @@
+#include "arena.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t size;
+} ArenaChunk;
+
+// four classes per power of two, a block wastes at most a fifth of its size
+const size_t arena_class_size[ARENA_CLASSES] = {16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512,
+                                               640, 768, 896, 1024, 1280, 1536, 1792, 2048, 2560, 3072, 3584, ARENA_MAX_BLOCK};
+
+// chunks, thread caches and the shared free lists
+pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+ArenaChunk *arena_chunks = NULL;
+size_t arena_chunk_count = 0;
+size_t arena_chunk_bytes = 0;
+ArenaCache *arena_caches = NULL;
+ArenaBlock *arena_shared[ARENA_CLASSES];
+// a thread's cache is only valid for the generation it was created in, a reset starts a new one
+size_t arena_generation = 1;
+_Thread_local ArenaCache *thread_cache = NULL;
+_Thread_local size_t thread_generation = 0;
+
+ArenaCache *arena_cache()
+{
+    if (thread_cache == NULL || thread_generation != arena_generation)
+    {
+        ArenaCache *cache = calloc(1, sizeof(*cache));
+        pthread_mutex_lock(&arena_lock);
+        cache->next = arena_caches;
+        arena_caches = cache;
+        pthread_mutex_unlock(&arena_lock);
+        thread_cache = cache;
+        thread_generation = arena_generation;
+    }
+    return thread_cache;
+}
+
+size_t arena_class(size_t size)
+{
+    size_t c = 0;
+    while (c < ARENA_CLASSES && arena_class_size[c] < size)
+    {
+        c++;
+    }
+    return c;
+}
+
+char *allocate_chunk(size_t size)
+{
+    // caller holds the arena lock
+    ArenaChunk *chunk = malloc(sizeof(*chunk) + size);
+    chunk->next = arena_chunks;
+    chunk->size = size;
+    arena_chunks = chunk;
+    arena_chunk_count++;
+    arena_chunk_bytes += size;
+    return (char *)(chunk + 1);
+}
+
+void refill(ArenaCache *cache, size_t c)
+{
+    size_t block_size = arena_class_size[c];
+    pthread_mutex_lock(&arena_lock);
+    // blocks freed by other threads first, then fresh ones from the chunk
+    if (arena_shared[c] != NULL)
+    {
+        cache->free[c] = arena_shared[c];
+        cache->n_free[c] = ARENA_BATCH;
+        arena_shared[c] = arena_shared[c]->batch;
+        pthread_mutex_unlock(&arena_lock);
+        return;
+    }
+    if ((size_t)(cache->end - cache->cursor) < block_size)
+    {
+        cache->cursor = allocate_chunk(ARENA_CHUNK);
+        cache->end = cache->cursor + ARENA_CHUNK;
+    }
+    pthread_mutex_unlock(&arena_lock);
+    for (size_t carved = 0; carved < ARENA_CARVE_BYTES && (size_t)(cache->end - cache->cursor) >= block_size; carved += block_size)
+    {
+        ArenaBlock *block = (ArenaBlock *)cache->cursor;
+        block->next = cache->free[c];
+        cache->free[c] = block;
+        cache->n_free[c]++;
+        cache->cursor += block_size;
+    }
+}
+
+void *arena_alloc(size_t size)
+{
+    ArenaCache *cache = arena_cache();
+    cache->allocations++;
+    cache->allocated_bytes += size;
+    size_t c = arena_class(size);
+    if (c == ARENA_CLASSES)
+    {
+        pthread_mutex_lock(&arena_lock);
+        char *block = allocate_chunk(size);
+        pthread_mutex_unlock(&arena_lock);
+        memset(block, 0, size);
+        return block;
+    }
+    if (cache->free[c] == NULL)
+    {
+        refill(cache, c);
+    }
+    ArenaBlock *block = cache->free[c];
+    cache->free[c] = block->next;
+    cache->n_free[c]--;
+    memset(block, 0, size);
+    return block;
+}
+
+void arena_free(void *block, size_t size)
+{
+    if (block == NULL)
+    {
+        return;
+    }
+    ArenaCache *cache = arena_cache();
+    cache->frees++;
+    cache->freed_bytes += size;
+    size_t c = arena_class(size);
+    if (c == ARENA_CLASSES)
+    {
+        return;
+    }
+    ArenaBlock *freed = block;
+    freed->next = cache->free[c];
+    cache->free[c] = freed;
+    // blocks are often freed by another thread than the one that allocated them, so a thread that
+    // mostly frees hands batches back instead of hoarding them
+    if (++cache->n_free[c] < 2 * ARENA_BATCH)
+    {
+        return;
+    }
+    ArenaBlock *last = freed;
+    for (size_t i = 1; i < ARENA_BATCH; i++)
+    {
+        last = last->next;
+    }
+    cache->free[c] = last->next;
+    cache->n_free[c] -= ARENA_BATCH;
+    last->next = NULL;
+    pthread_mutex_lock(&arena_lock);
+    freed->batch = arena_shared[c];
+    arena_shared[c] = freed;
+    pthread_mutex_unlock(&arena_lock);
+}
+
+void print_arena_usage()
+{
+    size_t allocations = 0, allocated_bytes = 0, frees = 0, freed_bytes = 0;
+    for (ArenaCache *cache = arena_caches; cache != NULL; cache = cache->next)
+    {
+        allocations += cache->allocations;
+        allocated_bytes += cache->allocated_bytes;
+        frees += cache->frees;
+        freed_bytes += cache->freed_bytes;
+    }
+    printf("arena: %lu allocations (%lu bytes), %lu freed (%lu bytes), %lu chunks (%lu bytes)\n",
+           allocations, allocated_bytes, frees, freed_bytes, arena_chunk_count, arena_chunk_bytes);
+}
+
+void arena_reset()
+{
+    while (arena_chunks != NULL)
+    {
+        ArenaChunk *chunk = arena_chunks;
+        arena_chunks = chunk->next;
+        free(chunk);
+    }
+    while (arena_caches != NULL)
+    {
+        ArenaCache *cache = arena_caches;
+        arena_caches = cache->next;
+        free(cache);
+    }
+    memset(arena_shared, 0, sizeof(arena_shared));
+    arena_chunk_count = 0;
+    arena_chunk_bytes = 0;
+    arena_generation++;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+// size classes of the blocks handed out, larger requests get a block of their own that lives until the reset
+#define ARENA_CLASSES 28
+#define ARENA_MAX_BLOCK 4096
+// blocks are carved from chunks of this size
+#define ARENA_CHUNK (256LU << 10)
+// blocks moved at once between a thread's free lists and the shared ones
+#define ARENA_BATCH 64
+// fresh blocks are carved a few at a time, so large classes do not sit unused in a thread's list
+#define ARENA_CARVE_BYTES (16LU << 10)
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    // next batch on a shared free list, only set on the first block of a batch
+    struct ArenaBlock *batch;
+} ArenaBlock;
+
+// free lists and counters of one thread, only the owning thread touches them
+typedef struct ArenaCache
+{
+    ArenaBlock *free[ARENA_CLASSES];
+    size_t n_free[ARENA_CLASSES];
+    // unused rest of the chunk the thread carves from
+    char *cursor;
+    char *end;
+    size_t allocations;
+    size_t allocated_bytes;
+    size_t frees;
+    size_t freed_bytes;
+    struct ArenaCache *next;
+} ArenaCache;
+
+// returns zeroed memory, the size has to be passed again when freeing the block
+void *arena_alloc(size_t size);
+
+void arena_free(void *block, size_t size);
+
+void print_arena_usage();
+
+// frees every block at once, no thread may use the arena while it is reset
+void arena_reset();
@@ -7,6 +7,10 @@ int main(int argc, char *argv[])
     size_t n_test = N_TEST;
     bool hard_mode = false;
     char *file_name = "result.json";
+    size_t n_threads = 0;
+    char *score_cache_file = "score_cache.bin";
+    size_t memo_budget = 0;
+    char *memo_spill_file = NULL;
     if (argc > 1)
     {
         hard_mode = strtol(argv[1], NULL, 0) == 1;
@@ -23,12 +27,34 @@ int main(int argc, char *argv[])
     {
         file_name = argv[4];
     }
+    if (argc > 5)
+    {
+        n_threads = strtol(argv[5], NULL, 0);
+    }
+    if (argc > 6)
+    {
+        // an empty path disables the score cache file
+        score_cache_file = argv[6][0] != '\0' ? argv[6] : NULL;
+    }
+    if (argc > 7)
+    {
+        // given in MiB
+        memo_budget = strtol(argv[7], NULL, 0) << 20;
+    }
+    if (argc > 8)
+    {
+        memo_spill_file = argv[8][0] != '\0' ? argv[8] : NULL;
+    }
     WordleInstance wordle_instance = {
         .n_hidden = n_hidden,
         .hidden_words = hidden_words,
         .n_test = n_test,
         .test_words = test_words,
         .hard_mode = hard_mode,
+        .n_threads = n_threads,
+        .score_cache_file = score_cache_file,
+        .memo_budget = memo_budget,
+        .memo_spill_file = memo_spill_file,
     };
     optimize_decision_tree(&wordle_instance, file_name);
     return 0;
@@ -0,0 +1,192 @@
+#include "memo_spill.h"
+#include "arena.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int spill_fd = -1;
+char *spill_mapping = NULL;
+// appends are serialized, records are read without the lock as they never change
+pthread_mutex_t spill_lock = PTHREAD_MUTEX_INITIALIZER;
+size_t spill_size = 0;
+size_t spill_end = 0;
+size_t spill_records = 0;
+atomic_size_t spill_loads = 0;
+
+bool memo_spill_open(const char *file_name)
+{
+    // the log only lives as long as the search, so the file is unlinked right away
+    spill_fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (spill_fd < 0)
+    {
+        return false;
+    }
+    unlink(file_name);
+    void *mapping = mmap(NULL, MEMO_SPILL_RESERVE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, spill_fd, 0);
+    if (mapping == MAP_FAILED || ftruncate(spill_fd, MEMO_SPILL_CHUNK) != 0)
+    {
+        if (mapping != MAP_FAILED)
+        {
+            munmap(mapping, MEMO_SPILL_RESERVE);
+        }
+        close(spill_fd);
+        spill_fd = -1;
+        return false;
+    }
+    spill_mapping = mapping;
+    spill_size = MEMO_SPILL_CHUNK;
+    // offset 0 is the magic, so no record starts there
+    memcpy(spill_mapping, MEMO_SPILL_MAGIC, sizeof(uint64_t));
+    spill_end = sizeof(uint64_t);
+    spill_records = 0;
+    atomic_store(&spill_loads, 0);
+    return true;
+}
+
+bool memo_spill_enabled()
+{
+    return spill_mapping != NULL;
+}
+
+hasmap_key_t *record_key(const SpillRecord *record)
+{
+    return (hasmap_key_t *)(record + 1);
+}
+
+SpillBranch *record_branches(const SpillRecord *record)
+{
+    return (SpillBranch *)((char *)record_key(record) + key_size(record_key(record)));
+}
+
+size_t append_record(const WordleNode *node, const SpillBranch *branches)
+{
+    // caller holds the spill lock
+    size_t size = sizeof(SpillRecord) + key_size(node->key) + node->num_branches * sizeof(SpillBranch);
+    if (spill_end + size > spill_size)
+    {
+        size_t new_size = spill_size + (size > MEMO_SPILL_CHUNK ? size : MEMO_SPILL_CHUNK);
+        if (new_size > MEMO_SPILL_RESERVE || ftruncate(spill_fd, new_size) != 0)
+        {
+            return 0;
+        }
+        spill_size = new_size;
+    }
+    SpillRecord *record = (SpillRecord *)(spill_mapping + spill_end);
+    *record = (SpillRecord){
+        .test_index = node->test_index,
+        .num_branches = node->num_branches,
+        .n_hidden = node->n_hidden,
+        .n_test = node->n_test,
+        .total = node->total,
+        .best_case = node->best_case,
+        .worst_case = node->worst_case,
+        .duration = node->duration,
+        .average_case = node->average_case,
+    };
+    hasmap_key_t *key = record_key(record);
+    memcpy(key, node->key, key_size(node->key));
+    key->hidden_vector = NULL;
+    key->test_vector = NULL;
+    memcpy(record_branches(record), branches, node->num_branches * sizeof(SpillBranch));
+    size_t offset = spill_end;
+    spill_end += size;
+    spill_records++;
+    return offset;
+}
+
+size_t write_node(WordleNode *node)
+{
+    // caller holds the spill lock, children that were spilled with an earlier parent are shared
+    if (node->spill_offset != 0)
+    {
+        return node->spill_offset;
+    }
+    SpillBranch branches[N_BRANCHES];
+    for (size_t i = 0; i < node->num_branches; i++)
+    {
+        branches[i].score = node->branches[i].score;
+        branches[i].offset = write_node(node->branches[i].node);
+        if (branches[i].offset == 0)
+        {
+            return 0;
+        }
+    }
+    node->spill_offset = append_record(node, branches);
+    return node->spill_offset;
+}
+
+size_t memo_spill_write(WordleNode *node)
+{
+    // 0 if the log is full
+    pthread_mutex_lock(&spill_lock);
+    size_t offset = write_node(node);
+    pthread_mutex_unlock(&spill_lock);
+    return offset;
+}
+
+const hasmap_key_t *memo_spill_key(size_t offset)
+{
+    return record_key((const SpillRecord *)(spill_mapping + offset));
+}
+
+WordleNode *memo_spill_load(size_t offset)
+{
+    // the caller owns the returned reference and fills in the children
+    atomic_fetch_add(&spill_loads, 1);
+    const SpillRecord *record = (const SpillRecord *)(spill_mapping + offset);
+    const hasmap_key_t *key = record_key(record);
+    WordleNode *node = arena_alloc(sizeof(*node));
+    node->test_index = record->test_index;
+    node->num_branches = record->num_branches;
+    node->duration = record->duration;
+    node->n_hidden = record->n_hidden;
+    node->n_test = record->n_test;
+    node->total = record->total;
+    node->best_case = record->best_case;
+    node->worst_case = record->worst_case;
+    node->average_case = record->average_case;
+    node->key = arena_alloc(key_size(key));
+    memcpy(node->key, key, key_size(key));
+    node->spill_offset = offset;
+    atomic_init(&node->refs, 1);
+    if (node->num_branches > 0)
+    {
+        const SpillBranch *branches = record_branches(record);
+        node->branches = arena_alloc(node->num_branches * sizeof(*node->branches));
+        for (size_t i = 0; i < node->num_branches; i++)
+        {
+            node->branches[i].score = branches[i].score;
+        }
+    }
+    return node;
+}
+
+size_t memo_spill_child(size_t offset, size_t i)
+{
+    return record_branches((const SpillRecord *)(spill_mapping + offset))[i].offset;
+}
+
+void print_memo_spill_usage()
+{
+    if (!memo_spill_enabled())
+    {
+        return;
+    }
+    printf("memo spill: wrote %lu records (%lu bytes), faulted back %lu nodes\n",
+           spill_records, spill_end, atomic_load(&spill_loads));
+}
+
+void memo_spill_close()
+{
+    if (!memo_spill_enabled())
+    {
+        return;
+    }
+    munmap(spill_mapping, MEMO_SPILL_RESERVE);
+    close(spill_fd);
+    spill_mapping = NULL;
+    spill_fd = -1;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "solver_hashmap.h"
+
+#define MEMO_SPILL_MAGIC "WRDLMEMO"
+// address space reserved for the log, the file itself only grows as records are appended
+#define MEMO_SPILL_RESERVE (1LU << 40)
+// minimum growth of the log file
+#define MEMO_SPILL_CHUNK (64LU << 20)
+
+// log layout: magic, then records appended one after another, a record is never changed once written
+typedef struct SpillRecord
+{
+    uint64_t test_index;
+    uint64_t num_branches;
+    uint64_t n_hidden;
+    uint64_t n_test;
+    uint64_t total;
+    uint64_t best_case;
+    uint64_t worst_case;
+    float duration;
+    float average_case;
+    // followed by the key with its words and then num_branches SpillBranch
+} SpillRecord;
+
+typedef struct SpillBranch
+{
+    uint64_t score;
+    // record of the child, written before its parent
+    uint64_t offset;
+} SpillBranch;
+
+bool memo_spill_open(const char *file_name);
+
+bool memo_spill_enabled();
+
+size_t memo_spill_write(WordleNode *node);
+
+const hasmap_key_t *memo_spill_key(size_t offset);
+
+// one node without its children, they are left NULL
+WordleNode *memo_spill_load(size_t offset);
+
+// record of the i-th child of a record
+size_t memo_spill_child(size_t offset, size_t i);
+
+void print_memo_spill_usage();
+
+void memo_spill_close();
@@ -0,0 +1,263 @@
+#include "scheduler.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+Worker *workers = NULL;
+size_t n_workers = 1;
+size_t n_started = 1;
+pthread_t *worker_threads = NULL;
+atomic_bool scheduler_running = false;
+// the thread that calls scheduler_init() is worker 0
+_Thread_local Worker *current_worker = NULL;
+_Thread_local Task *current_task = NULL;
+// threads out of work sleep here until something is spawned or a stolen task finishes
+pthread_mutex_t park_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t park_cond = PTHREAD_COND_INITIALIZER;
+atomic_size_t n_parked = 0;
+
+void wake_parked()
+{
+    // pairs with the increment in park(), either the parked thread sees the change or we see it parked
+    if (atomic_load(&n_parked) > 0)
+    {
+        pthread_mutex_lock(&park_lock);
+        pthread_cond_broadcast(&park_cond);
+        pthread_mutex_unlock(&park_lock);
+    }
+}
+
+bool work_queued()
+{
+    for (size_t i = 0; i < n_workers; i++)
+    {
+        if (atomic_load(&workers[i].head) != atomic_load(&workers[i].tail))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void park(const Task *joined, long timeout_ns)
+{
+    pthread_mutex_lock(&park_lock);
+    atomic_fetch_add(&n_parked, 1);
+    if (joined != NULL)
+    {
+        // a descendant can also become stealable when another thief takes the task in front of it, which wakes
+        // nobody, so joiners only sleep for a while
+        if (!atomic_load(&joined->done))
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += timeout_ns;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+            pthread_cond_timedwait(&park_cond, &park_lock, &deadline);
+        }
+    }
+    else if (atomic_load(&scheduler_running) && !work_queued())
+    {
+        pthread_cond_wait(&park_cond, &park_lock);
+    }
+    atomic_fetch_sub(&n_parked, 1);
+    pthread_mutex_unlock(&park_lock);
+}
+
+void execute_task(Task *task)
+{
+    Task *parent = current_task;
+    current_task = task;
+    task->run(task);
+    current_task = parent;
+    // the joiner may release the task as soon as it is done
+    bool stolen = atomic_load(&task->thief) != NULL;
+    atomic_store(&task->done, true);
+    if (stolen)
+    {
+        wake_parked();
+    }
+}
+
+bool descends_from(const Task *task, const Task *ancestor)
+{
+    for (; task != NULL; task = task->parent)
+    {
+        if (task == ancestor)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Task *steal_task(Worker *victim, const Task *ancestor)
+{
+    // empty deques are skipped without touching the lock and a busy one is left alone, so thieves never make
+    // the owner wait for them
+    if (atomic_load(&victim->head) == atomic_load(&victim->tail) || pthread_mutex_trylock(&victim->lock) != 0)
+    {
+        return NULL;
+    }
+    // ancestors outlive their queued descendants, they are only done after joining them
+    Task *task = NULL;
+    size_t head = atomic_load(&victim->head);
+    if (head != atomic_load(&victim->tail) &&
+        (ancestor == NULL || descends_from(victim->tasks[head % SCHEDULER_DEQUE_SIZE], ancestor)))
+    {
+        task = victim->tasks[head % SCHEDULER_DEQUE_SIZE];
+        atomic_store(&victim->head, head + 1);
+        atomic_store(&task->thief, current_worker);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    return task;
+}
+
+void *run_worker(void *arg)
+{
+    current_worker = arg;
+    size_t victim = current_worker->id;
+    size_t spins = 0;
+    while (atomic_load(&scheduler_running))
+    {
+        Task *task = NULL;
+        for (size_t i = 1; i < n_workers && task == NULL; i++)
+        {
+            victim = (victim + 1) % n_workers;
+            task = steal_task(&workers[victim], NULL);
+        }
+        if (task != NULL)
+        {
+            execute_task(task);
+            spins = 0;
+        }
+        else if (++spins < SCHEDULER_SPINS)
+        {
+            sched_yield();
+        }
+        else
+        {
+            park(NULL, 0);
+        }
+    }
+    return NULL;
+}
+
+void scheduler_init(size_t n_threads)
+{
+    n_workers = n_threads > 0 ? n_threads : 1;
+    workers = calloc(n_workers, sizeof(*workers));
+    worker_threads = calloc(n_workers, sizeof(*worker_threads));
+    for (size_t i = 0; i < n_workers; i++)
+    {
+        workers[i].id = i;
+        pthread_mutex_init(&workers[i].lock, NULL);
+    }
+    current_worker = &workers[0];
+    atomic_store(&scheduler_running, true);
+    // workers that could not be started keep an empty deque, nobody pushes to it
+    for (n_started = 1; n_started < n_workers; n_started++)
+    {
+        if (pthread_create(&worker_threads[n_started], NULL, run_worker, &workers[n_started]) != 0)
+        {
+            break;
+        }
+    }
+}
+
+size_t scheduler_workers()
+{
+    return n_workers;
+}
+
+size_t scheduler_worker_id()
+{
+    return current_worker->id;
+}
+
+void scheduler_spawn(Task *task)
+{
+    task->parent = current_task;
+    atomic_store(&task->done, false);
+    atomic_store(&task->thief, NULL);
+    Worker *worker = current_worker;
+    // only the owner moves the tail, a stale head merely underestimates the free slots
+    size_t tail = atomic_load(&worker->tail);
+    if (tail - atomic_load(&worker->head) >= SCHEDULER_DEQUE_SIZE)
+    {
+        execute_task(task);
+        return;
+    }
+    worker->tasks[tail % SCHEDULER_DEQUE_SIZE] = task;
+    atomic_store(&worker->tail, tail + 1);
+    wake_parked();
+}
+
+void scheduler_join(Task *task)
+{
+    // tasks have to be joined in reverse spawn order
+    Worker *worker = current_worker;
+    size_t spins = 0;
+    long park_ns = SCHEDULER_MIN_PARK_NS;
+    while (!atomic_load(&task->done))
+    {
+        Task *next = NULL;
+        if (atomic_load(&worker->head) != atomic_load(&worker->tail))
+        {
+            // popping races with thieves for the last task, so it takes the lock
+            pthread_mutex_lock(&worker->lock);
+            size_t tail = atomic_load(&worker->tail);
+            if (tail != atomic_load(&worker->head) && worker->tasks[(tail - 1) % SCHEDULER_DEQUE_SIZE] == task)
+            {
+                next = task;
+                atomic_store(&worker->tail, tail - 1);
+            }
+            pthread_mutex_unlock(&worker->lock);
+        }
+        // help the thief with the stolen task's own subtasks instead of idling, a joining thread never runs
+        // unrelated work so that everything on its stack works on ever smaller subsets
+        Worker *thief = atomic_load(&task->thief);
+        if (next == NULL && thief != NULL)
+        {
+            next = steal_task(thief, task);
+        }
+        if (next != NULL)
+        {
+            execute_task(next);
+            spins = 0;
+            park_ns = SCHEDULER_MIN_PARK_NS;
+        }
+        else if (++spins < SCHEDULER_SPINS)
+        {
+            sched_yield();
+        }
+        else
+        {
+            park(task, park_ns);
+            park_ns = park_ns < SCHEDULER_MAX_PARK_NS / 2 ? 2 * park_ns : SCHEDULER_MAX_PARK_NS;
+        }
+    }
+}
+
+void scheduler_shutdown()
+{
+    atomic_store(&scheduler_running, false);
+    pthread_mutex_lock(&park_lock);
+    pthread_cond_broadcast(&park_cond);
+    pthread_mutex_unlock(&park_lock);
+    for (size_t i = 1; i < n_started; i++)
+    {
+        pthread_join(worker_threads[i], NULL);
+    }
+    for (size_t i = 0; i < n_workers; i++)
+    {
+        pthread_mutex_destroy(&workers[i].lock);
+    }
+    free(worker_threads);
+    free(workers);
+    worker_threads = NULL;
+    workers = NULL;
+    n_workers = 1;
+    n_started = 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// queued tasks per worker, a full deque runs new tasks right away
+#define SCHEDULER_DEQUE_SIZE 4096
+// failed steal rounds before a thread parks
+#define SCHEDULER_SPINS 64
+// a parked joiner rechecks its task at least this often, doubling from the minimum
+#define SCHEDULER_MIN_PARK_NS 50000L
+#define SCHEDULER_MAX_PARK_NS 1000000L
+
+typedef struct Task
+{
+    void (*run)(struct Task *task);
+    // task that was running when this one was spawned, a joining thread only helps with descendants of its task
+    struct Task *parent;
+    atomic_bool done;
+    // worker that stole the task, NULL while it is queued or when its owner ran it
+    struct Worker *_Atomic thief;
+} Task;
+
+typedef struct Worker
+{
+    size_t id;
+    // held by thieves and by the owner when popping, the owner pushes without it
+    pthread_mutex_t lock;
+    // owner pushes and pops at tail, thieves take the oldest task at head
+    atomic_size_t head;
+    atomic_size_t tail;
+    Task *tasks[SCHEDULER_DEQUE_SIZE];
+} Worker;
+
+void scheduler_init(size_t n_workers);
+
+size_t scheduler_workers();
+
+size_t scheduler_worker_id();
+
+void scheduler_spawn(Task *task);
+
+void scheduler_join(Task *task);
+
+void scheduler_shutdown();
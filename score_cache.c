@@ -0,0 +1,288 @@
+#include "score_cache.h"
+#include <fcntl.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t checksum_letters(const char *letters, size_t n)
+{
+    // FNV-1a over the packed five letter words
+    uint64_t checksum = 0xcbf29ce484222325LU;
+    for (size_t i = 0; i < 5 * n; i++)
+    {
+        checksum ^= (uint8_t)letters[i];
+        checksum *= 0x100000001b3LU;
+    }
+    return checksum;
+}
+
+char *pack_words(const char (*words)[6], size_t n)
+{
+    char *letters = malloc(5 * n + 1);
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(letters + 5 * i, words[i], 5);
+    }
+    return letters;
+}
+
+bool match_words(const char *stored, const char (*words)[6], size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (memcmp(stored + 5 * i, words[i], 5) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool map_score_cache(const WordleInstance *wordle_instance, ScoreCache *score_cache)
+{
+    int fd = open(wordle_instance->score_cache_file, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ScoreCacheHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // the file may cover a superset of the instance, as long as the word lists are prefixes of the stored ones
+    const ScoreCacheHeader *header = mapping;
+    const char *stored_test = (const char *)(header + 1);
+    const char *stored_hidden = stored_test + 5 * header->n_test;
+    bool valid = memcmp(header->magic, SCORE_CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == SCORE_CACHE_VERSION &&
+                 header->n_test <= size && header->n_hidden <= size &&
+                 header->matrix_offset >= sizeof(*header) + 5 * (header->n_test + header->n_hidden) &&
+                 header->matrix_offset <= size &&
+                 (header->n_hidden == 0 || (size - header->matrix_offset) / header->n_hidden >= header->n_test);
+    valid = valid &&
+            header->n_test >= wordle_instance->n_test &&
+            header->n_hidden >= wordle_instance->n_hidden &&
+            checksum_letters(stored_test, header->n_test) == header->test_checksum &&
+            checksum_letters(stored_hidden, header->n_hidden) == header->hidden_checksum &&
+            match_words(stored_test, wordle_instance->test_words, wordle_instance->n_test) &&
+            match_words(stored_hidden, wordle_instance->hidden_words, wordle_instance->n_hidden);
+    if (!valid)
+    {
+        munmap(mapping, size);
+        return false;
+    }
+
+    const uint8_t *matrix = (const uint8_t *)mapping + header->matrix_offset;
+    score_cache->rows = malloc(sizeof(uint8_t *) * wordle_instance->n_test);
+    for (size_t i = 0; i < wordle_instance->n_test; i++)
+    {
+        score_cache->rows[i] = matrix + header->n_hidden * i;
+    }
+    score_cache->mapping = mapping;
+    score_cache->mapping_size = size;
+    return true;
+}
+
+bool write_all(int fd, const void *data, size_t size)
+{
+    const char *ptr = data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, ptr, size);
+        if (written <= 0)
+        {
+            return false;
+        }
+        ptr += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool write_score_cache(const WordleInstance *wordle_instance, uint8_t **score_cache)
+{
+    // write to a private file and rename it, so concurrent readers never see a partial matrix
+    size_t path_size = strlen(wordle_instance->score_cache_file) + 32;
+    char tmp_path[path_size];
+    snprintf(tmp_path, path_size, "%s.%ld.tmp", wordle_instance->score_cache_file, (long)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    char *test_letters = pack_words(wordle_instance->test_words, wordle_instance->n_test);
+    char *hidden_letters = pack_words(wordle_instance->hidden_words, wordle_instance->n_hidden);
+    ScoreCacheHeader header = {
+        .magic = SCORE_CACHE_MAGIC,
+        .version = SCORE_CACHE_VERSION,
+        .n_test = wordle_instance->n_test,
+        .n_hidden = wordle_instance->n_hidden,
+        .test_checksum = checksum_letters(test_letters, wordle_instance->n_test),
+        .hidden_checksum = checksum_letters(hidden_letters, wordle_instance->n_hidden),
+    };
+    // align the matrix to a cache line
+    header.matrix_offset = (sizeof(header) + 5 * (header.n_test + header.n_hidden) + 63) / 64 * 64;
+
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, test_letters, 5 * header.n_test) &&
+              write_all(fd, hidden_letters, 5 * header.n_hidden);
+    free(test_letters);
+    free(hidden_letters);
+    char padding[64] = {0};
+    size_t offset = sizeof(header) + 5 * (header.n_test + header.n_hidden);
+    ok = ok && write_all(fd, padding, header.matrix_offset - offset);
+    // rows are contiguous behind the row pointers
+    ok = ok && (wordle_instance->n_test == 0 ||
+                write_all(fd, score_cache[0], wordle_instance->n_test * wordle_instance->n_hidden));
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(tmp_path, wordle_instance->score_cache_file) == 0;
+    if (!ok)
+    {
+        unlink(tmp_path);
+    }
+    return ok;
+}
+
+bool root_prunes(ScoreCache *score_cache)
+{
+    // mirrors the first pass of sort_test_vector, hidden words share their index with the test words
+    const WordleInstance *wordle_instance = score_cache->wordle_instance;
+    size_t n_hidden = wordle_instance->n_hidden;
+    if (n_hidden <= 2)
+    {
+        return true;
+    }
+    // a guess has at most 3^5 scores
+    if (n_hidden > 243)
+    {
+        return false;
+    }
+    for (size_t j = 0; j < n_hidden && j < wordle_instance->n_test; j++)
+    {
+        const uint8_t *row = populate_score_cache_row(score_cache, j);
+        uint64_t seen[4] = {0};
+        size_t n_scores = 0;
+        for (size_t k = 0; k < n_hidden; k++)
+        {
+            uint8_t score = row[k];
+            if (!(seen[score >> 6] >> (score & 63) & 1))
+            {
+                seen[score >> 6] |= 1LU << (score & 63);
+                n_scores++;
+            }
+        }
+        if (n_scores == n_hidden)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void load_score_cache(const WordleInstance *wordle_instance, ScoreCache *score_cache)
+{
+    *score_cache = (ScoreCache){
+        .n_rows = wordle_instance->n_test,
+        .wordle_instance = wordle_instance,
+    };
+    if (wordle_instance->score_cache_file != NULL && map_score_cache(wordle_instance, score_cache))
+    {
+        return;
+    }
+
+    // rows are only worth scoring on demand if the root prunes on a hidden word, ranking the guesses
+    // reads every row otherwise
+    score_cache->lazy = true;
+    score_cache->rows = (const uint8_t **)allocate_score_cache(wordle_instance->n_test, wordle_instance->n_hidden);
+    score_cache->row_state = calloc(wordle_instance->n_test + 1, sizeof(*score_cache->row_state));
+    score_cache->columns = transpose_hidden_words(wordle_instance);
+    if (root_prunes(score_cache))
+    {
+        return;
+    }
+    free_score_cache(score_cache);
+    score_cache->lazy = false;
+    atomic_store(&score_cache->rows_computed, 0);
+
+    // missing or stale: rebuild, then share the rewritten file instead of the private copy
+    uint8_t **rows = populate_score_cache(wordle_instance);
+    if (wordle_instance->score_cache_file == NULL)
+    {
+        score_cache->rows = (const uint8_t **)rows;
+        return;
+    }
+    if (!write_score_cache(wordle_instance, rows))
+    {
+        printf("Could not write score cache %s!\n", wordle_instance->score_cache_file);
+    }
+    else if (map_score_cache(wordle_instance, score_cache))
+    {
+        free(rows);
+        return;
+    }
+    score_cache->rows = (const uint8_t **)rows;
+}
+
+const uint8_t *populate_score_cache_row(ScoreCache *score_cache, size_t test_index)
+{
+    _Atomic uint8_t *state = &score_cache->row_state[test_index];
+    uint8_t expected = ROW_EMPTY;
+    if (atomic_compare_exchange_strong_explicit(state, &expected, ROW_BUSY, memory_order_acquire, memory_order_acquire))
+    {
+        score_row(score_cache->wordle_instance->test_words[test_index], &score_cache->columns,
+                  (uint8_t *)score_cache->rows[test_index]);
+        atomic_fetch_add_explicit(&score_cache->rows_computed, 1, memory_order_relaxed);
+        atomic_store_explicit(state, ROW_READY, memory_order_release);
+    }
+    else
+    {
+        // another thread is scoring this row
+        while (atomic_load_explicit(state, memory_order_acquire) != ROW_READY)
+        {
+            sched_yield();
+        }
+    }
+    return score_cache->rows[test_index];
+}
+
+void print_score_cache_usage(const ScoreCache *score_cache)
+{
+    if (!score_cache->lazy)
+    {
+        return;
+    }
+    size_t rows_computed = atomic_load(&score_cache->rows_computed);
+    size_t n_hidden = score_cache->wordle_instance->n_hidden;
+    printf("score cache: computed %lu of %lu rows (%lu of %lu bytes, %f%%)\n",
+           rows_computed, score_cache->n_rows, rows_computed * n_hidden, score_cache->n_rows * n_hidden,
+           score_cache->n_rows > 0 ? (100.0 * rows_computed) / score_cache->n_rows : 0.0);
+}
+
+void free_score_cache(ScoreCache *score_cache)
+{
+    if (score_cache->mapping != NULL)
+    {
+        munmap(score_cache->mapping, score_cache->mapping_size);
+    }
+    free(score_cache->rows);
+    free(score_cache->row_state);
+    free(score_cache->columns.letters);
+    score_cache->rows = NULL;
+    score_cache->mapping = NULL;
+    score_cache->row_state = NULL;
+    score_cache->columns.letters = NULL;
+}
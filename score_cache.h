@@ -0,0 +1,57 @@
+#pragma once
+
+#include "wordle.h"
+#include <stdatomic.h>
+
+#define SCORE_CACHE_MAGIC "WRDLSCR"
+#define SCORE_CACHE_VERSION 1
+
+#define ROW_EMPTY 0
+#define ROW_BUSY 1
+#define ROW_READY 2
+
+// on-disk layout: header, test words, hidden words, then the n_test x n_hidden matrix
+typedef struct ScoreCacheHeader
+{
+    char magic[8];
+    uint64_t version;
+    uint64_t n_test;
+    uint64_t n_hidden;
+    uint64_t test_checksum;
+    uint64_t hidden_checksum;
+    uint64_t matrix_offset;
+} ScoreCacheHeader;
+
+typedef struct ScoreCache
+{
+    // rows[test_index][hidden_index]
+    const uint8_t **rows;
+    // read-only mapping of the cache file, NULL if the matrix lives on the heap
+    void *mapping;
+    size_t mapping_size;
+    // lazy mode: rows are scored on first access through score_cache_row()
+    bool lazy;
+    size_t n_rows;
+    _Atomic uint8_t *row_state;
+    atomic_size_t rows_computed;
+    const WordleInstance *wordle_instance;
+    ScoreColumns columns;
+} ScoreCache;
+
+void load_score_cache(const WordleInstance *wordle_instance, ScoreCache *score_cache);
+
+const uint8_t *populate_score_cache_row(ScoreCache *score_cache, size_t test_index);
+
+static inline const uint8_t *score_cache_row(ScoreCache *score_cache, size_t test_index)
+{
+    if (score_cache->lazy &&
+        atomic_load_explicit(&score_cache->row_state[test_index], memory_order_acquire) != ROW_READY)
+    {
+        return populate_score_cache_row(score_cache, test_index);
+    }
+    return score_cache->rows[test_index];
+}
+
+void print_score_cache_usage(const ScoreCache *score_cache);
+
+void free_score_cache(ScoreCache *score_cache);
@@ -1,12 +1,18 @@
 #include "solver.h"
+#include "arena.h"
 #include "result.h"
+#include "scheduler.h"
+#include "score_cache.h"
 #include "solver_hashmap.h"
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 #define LOG_DEPTH 1
-#define SEARCH_DEPTH 50
-#define SEARCH_ENTROPY_DEPTH 0.75
+// nodes below this depth and with at least this many hidden words spread their work as tasks
+#define TASK_MAX_DEPTH 3
+#define TASK_MIN_HIDDEN 32
 #define PADDING(depth)                     \
     {                                      \
         for (size_t i = 0; i < depth; i++) \
@@ -17,141 +23,324 @@
 
 WordleNode *optimize(const WordleSolverInstance *solver_instance, size_t beta);
 
-size_t filter_test_words(const WordleSolverInstance *solver_instance, const size_t test_index, const uint8_t score)
+size_t filter_test_words(const WordleSolverInstance *solver_instance, index_t *filtered, const size_t test_index, const uint8_t score)
 {
-
-    size_t n_test = 0;
+    // valid test words keep every green letter in place and contain every revealed letter at least as often
     const char *test_word = solver_instance->wordle_instance->test_words[test_index];
-    char exact_chars[5] = {0};
-    char included_chars[5] = {0};
+    const size_t n_words = filter_index.n_words;
+    uint64_t allowed[n_words];
+    memcpy(allowed, solver_instance->test_set, sizeof(allowed));
+    uint8_t included[26] = {0};
     uint8_t tmp_score = score;
     for (size_t i = 0; i < 5; i++)
     {
-        if (tmp_score % 3 != 0)
+        size_t letter = test_word[i] - 'a';
+        if (tmp_score % 3 == 2)
         {
-            included_chars[i] = test_word[i];
+            const uint64_t *at = filter_index.at + (i * 26 + letter) * n_words;
+            for (size_t w = 0; w < n_words; w++)
+            {
+                allowed[w] &= at[w];
+            }
         }
-        if (tmp_score % 3 == 2)
+        if (tmp_score % 3 != 0)
         {
-            exact_chars[i] = test_word[i];
+            included[letter]++;
         }
         tmp_score /= 3;
     }
-    // assign every valid test word value one, zero otherwise
-    for (size_t i = 0; i < solver_instance->n_test; i++)
+    for (size_t letter = 0; letter < 26; letter++)
     {
-        char test_included_chars[5];
-        for (size_t j = 0; j < 5; j++)
-        {
-            test_included_chars[j] = included_chars[j];
-        }
-        test_word = solver_instance->wordle_instance->test_words[solver_instance->test_vector[i].index];
-        bool valid = true;
-        for (size_t j = 0; j < 5; j++)
+        if (included[letter] > 0)
         {
-            if (exact_chars[j] != 0 && exact_chars[j] != test_word[j])
+            const uint64_t *at_least = filter_index.at_least + (letter * 5 + included[letter] - 1) * n_words;
+            for (size_t w = 0; w < n_words; w++)
             {
-                valid = false;
-                break;
-            }
-            for (size_t k = 0; k < 5; k++)
-            {
-
-                if (test_included_chars[k] != 0 && test_included_chars[k] == test_word[j])
-                {
-                    test_included_chars[k] = 0;
-                    break;
-                }
-            }
-        }
-        for (size_t j = 0; j < 5; j++)
-        {
-            if (test_included_chars[j] != 0)
-            {
-                valid = false;
-                break;
+                allowed[w] &= at_least[w];
             }
         }
-        if (valid)
-        {
-            n_test++;
-            solver_instance->test_vector[i].value = 1;
-        }
-        else
+    }
+
+    // ascending order without sorting
+    size_t n_test = 0;
+    for (size_t w = 0; w < n_words; w++)
+    {
+        for (uint64_t bits = allowed[w]; bits != 0; bits &= bits - 1)
         {
-            solver_instance->test_vector[i].value = 0;
+            filtered[n_test++] = 64 * w + __builtin_ctzll(bits);
         }
     }
-    qsort(solver_instance->test_vector, solver_instance->n_test, sizeof(tuple), compare_tuples);
     return n_test;
 }
 
-size_t sum_branch_total(const WordleSolverInstance *solver_instance, Branch *branch, const size_t beta, WordleBranch *branch_nodes)
+// buffers of the worker running the current task
+typedef struct SolverContext
 {
-    size_t total = 2 * solver_instance->n_hidden - branch->sizes[N_BRANCHES - 1].value;
+    // tile of the node packed at each depth, allocated once a node that small is reached there
+    uint8_t *packed_buffers[MAX_DEPTH];
+    size_t packed_sizes[MAX_DEPTH];
+    PartitionTable partition_table;
+    // hard mode only, the allowed test words of a node as a bitset and the filtered ones of its children,
+    // children at MAX_DEPTH are compressed but never solved
+    uint64_t *test_sets[MAX_DEPTH];
+    index_t *test_buffers[MAX_DEPTH + 1];
+    // entropies of the node being ranked, copied out before any child is ranked
+    double *test_values;
+    // partition of the node being branched at each depth, its children read their hidden words from it
+    // while they are solved, index arrays are sized for the root
+    Branch branches[MAX_DEPTH];
+} SolverContext;
 
-    // branch total is already too large
-    if (total >= beta)
+SolverContext *solver_contexts = NULL;
+
+SolverContext *solver_context()
+{
+    return &solver_contexts[scheduler_worker_id()];
+}
+
+uint8_t *packed_buffer(const WordleInstance *wordle_instance, size_t depth, size_t n_hidden)
+{
+    // tiles are indexed by test word, the buffer grows with the largest node packed at its depth. a worker
+    // only starts another node at a depth once the last one there and every task reading its tile are done
+    SolverContext *context = solver_context();
+    // columns are rounded up to a power of two, so a depth is reallocated only a few times
+    size_t columns = 4;
+    while (columns < n_hidden)
     {
-        return UINTMAX_MAX;
+        columns *= 2;
+    }
+    size_t size = wordle_instance->n_test * columns + 1;
+    if (context->packed_sizes[depth] < size)
+    {
+        free(context->packed_buffers[depth]);
+        context->packed_buffers[depth] = malloc(size);
+        context->packed_sizes[depth] = size;
     }
+    return context->packed_buffers[depth];
+}
+
+bool spawn_tasks(const WordleSolverInstance *solver_instance)
+{
+    return scheduler_workers() > 1 && solver_instance->depth < TASK_MAX_DEPTH && solver_instance->n_hidden >= TASK_MIN_HIDDEN;
+}
 
-    // Sort branch sizes: solve small branches first
-    qsort(branch->sizes, N_BRANCHES, sizeof(tuple), compare_tuples);
+index_t *copy_test_vector(const WordleSolverInstance *solver_instance)
+{
+    // normal mode children rank the test words in place, hard mode ones filter their own from the node's
+    // test set into worker buffers and never touch the node's vector, so tasks can share it
+    if (solver_instance->wordle_instance->hard_mode)
+    {
+        return solver_instance->test_vector;
+    }
+    index_t *test_vector = malloc(solver_instance->n_test * sizeof(*test_vector));
+    memcpy(test_vector, solver_instance->test_vector, solver_instance->n_test * sizeof(*test_vector));
+    return test_vector;
+}
 
-    size_t progress = solver_instance->n_hidden;
-    for (size_t i = branch->count; (total < beta) && (i-- > 0);)
+void free_test_vector(const WordleSolverInstance *solver_instance, index_t *test_vector)
+{
+    if (!solver_instance->wordle_instance->hard_mode)
     {
-        size_t score = branch->sizes[i].index;
-        size_t size = branch->sizes[i].value;
-        size_t start = branch->starts[score];
+        free(test_vector);
+    }
+}
 
-        if (size == solver_instance->n_hidden)
-        {
-            total = UINTMAX_MAX;
-            break;
-        }
+typedef struct CandidateJob
+{
+    const WordleSolverInstance *solver_instance;
+    const tuple *test_ordering;
+    size_t beta;
+    // best (total, candidate) packed as total * SEARCH_DEPTH + candidate, UINT64_MAX while there is none
+    _Atomic uint64_t best;
+    WordleNode *candidates;
+} CandidateJob;
 
-        size_t n_test = solver_instance->n_test;
+size_t candidate_beta(CandidateJob *job, size_t candidate)
+{
+    uint64_t best = atomic_load(&job->best);
+    if (best == UINT64_MAX)
+    {
+        return job->beta;
+    }
+    // candidates ranked before the best one win ties, so they may still match its total
+    size_t total = best / SEARCH_DEPTH;
+    return candidate < best % SEARCH_DEPTH ? total + 1 : total;
+}
+
+typedef struct BranchJob
+{
+    const WordleSolverInstance *solver_instance;
+    Branch *branch;
+    size_t beta;
+    // set while the branches of a candidate are solved, they are also cut off by the best candidate so far
+    CandidateJob *candidates;
+    size_t candidate;
+    // lower bound of the node total, finished children add what they need beyond one more guess per word
+    atomic_size_t total;
+    atomic_bool failed;
+    atomic_size_t progress;
+    WordleBranch *branch_nodes;
+} BranchJob;
+
+typedef struct BranchTask
+{
+    Task task;
+    BranchJob *job;
+    size_t i;
+    index_t *test_vector;
+} BranchTask;
+
+size_t branch_beta(BranchJob *job)
+{
+    if (job->candidates == NULL)
+    {
+        return job->beta;
+    }
+    size_t beta = candidate_beta(job->candidates, job->candidate);
+    return beta < job->beta ? beta : job->beta;
+}
+
+bool solve_branch(BranchJob *job, size_t i, index_t *test_vector)
+{
+    const WordleSolverInstance *solver_instance = job->solver_instance;
+    Branch *branch = job->branch;
+    size_t total = atomic_load(&job->total);
+    size_t beta = branch_beta(job);
+    // a sibling already failed or pushed the total over beta, the node's partial total is discarded
+    if (atomic_load(&job->failed) || total >= beta)
+    {
+        atomic_store(&job->failed, true);
+        return false;
+    }
+
+    const Bucket *bucket = &branch->buckets[i];
+    size_t score = bucket->score;
+    size_t size = bucket->size;
+    size_t start = bucket->start;
+
+    if (size == solver_instance->n_hidden)
+    {
+        atomic_store(&job->failed, true);
+        return false;
+    }
+
+    size_t n_test = solver_instance->n_test;
+    SolverContext *context = solver_context();
+
+    if (solver_instance->wordle_instance->hard_mode)
+    {
+        // filtered into a buffer of its own, this node's test words are read by every branch
+        test_vector = context->test_buffers[solver_instance->depth + 1];
+        n_test = filter_test_words(solver_instance, test_vector, branch->test_index, score);
+    }
+
+    // children re-pack from this node's tile if it has one
+    bool packed = solver_instance->packed_scores != NULL;
+    WordleSolverInstance sub_instance = {
+        .wordle_instance = solver_instance->wordle_instance,
+        .n_hidden = size,
+        .hidden_vector = branch->hidden_indicies + start,
+        .n_test = n_test,
+        .test_vector = test_vector,
+        .test_values = context->test_values,
+        .score_cache = solver_instance->score_cache,
+        .parent_scores = packed ? solver_instance->packed_scores : NULL,
+        .parent_n_hidden = solver_instance->n_hidden,
+        .columns = packed ? branch->columns + start : branch->hidden_indicies + start,
+        .partition_table = &context->partition_table,
+        .fingerprint = bucket->fingerprint,
+        .depth = solver_instance->depth + 1};
+    WordleNode *node = optimize(&sub_instance, beta - total + size);
+    if (node == NULL)
+    {
+        atomic_store(&job->failed, true);
+        return false;
+    }
+
+    job->branch_nodes[i].node = node;
+    job->branch_nodes[i].score = score;
+
+    if (solver_instance->depth < LOG_DEPTH)
+    {
+        PADDING(solver_instance->depth)
+        char decoded[25];
+        descore(score, decoded);
+        size_t progress = atomic_fetch_sub(&job->progress, size) - size;
+        printf("%s - %f%% (%lu + %lu - %lu / %lu, %lu)\n", decoded, (100.0 * progress) / solver_instance->n_hidden, total, node->total, size, job->beta, n_test);
+    }
+
+    total = atomic_fetch_add(&job->total, node->total - size) + node->total - size;
+    if (total >= branch_beta(job))
+    {
+        atomic_store(&job->failed, true);
+        return false;
+    }
+    return true;
+}
+
+void run_branch_task(Task *task)
+{
+    BranchTask *branch_task = (BranchTask *)task;
+    solve_branch(branch_task->job, branch_task->i, branch_task->test_vector);
+    free_test_vector(branch_task->job->solver_instance, branch_task->test_vector);
+}
+
+size_t sum_branch_total(const WordleSolverInstance *solver_instance, Branch *branch, const size_t beta, WordleBranch *branch_nodes,
+                        CandidateJob *candidates, size_t candidate)
+{
+    // buckets come largest first: solve small branches first
+    size_t total = 2 * solver_instance->n_hidden - branch->solved;
+    BranchJob job = {
+        .solver_instance = solver_instance,
+        .branch = branch,
+        .beta = beta,
+        .candidates = candidates,
+        .candidate = candidate,
+        .total = total,
+        .failed = false,
+        .progress = solver_instance->n_hidden,
+        .branch_nodes = branch_nodes,
+    };
+
+    // branch total is already too large
+    if (total >= branch_beta(&job))
+    {
+        return UINTMAX_MAX;
+    }
 
-        if (solver_instance->wordle_instance->hard_mode)
+    if (spawn_tasks(solver_instance))
+    {
+        // large branches become tasks with their own test words, spawned largest first as thieves take the oldest
+        BranchTask *tasks = calloc(branch->count, sizeof(*tasks));
+        size_t n_tasks = 0;
+        for (; n_tasks < branch->count && branch->buckets[n_tasks].size >= TASK_MIN_HIDDEN; n_tasks++)
         {
-            n_test = filter_test_words(solver_instance, branch->test_index, score);
+            tasks[n_tasks].task.run = run_branch_task;
+            tasks[n_tasks].job = &job;
+            tasks[n_tasks].i = n_tasks;
+            tasks[n_tasks].test_vector = copy_test_vector(solver_instance);
+            scheduler_spawn(&tasks[n_tasks].task);
         }
-
-        WordleSolverInstance sub_instance = {
-            .wordle_instance = solver_instance->wordle_instance,
-            .n_hidden = size,
-            .hidden_vector = branch->hidden_indicies + start,
-            .n_test = n_test,
-            .test_vector = solver_instance->test_vector,
-            .score_cache = solver_instance->score_cache,
-            .depth = solver_instance->depth + 1};
-        WordleNode *node = optimize(&sub_instance, beta - total + size);
-        if (node == NULL)
+        for (size_t i = branch->count; (i-- > n_tasks) && solve_branch(&job, i, solver_instance->test_vector);)
         {
-            total = UINTMAX_MAX;
-            break;
         }
-
-        branch_nodes[i].node = node;
-        branch_nodes[i].score = score;
-
-        if (solver_instance->depth < LOG_DEPTH)
+        for (size_t i = n_tasks; i-- > 0;)
         {
-            PADDING(solver_instance->depth)
-            char decoded[25];
-            descore(score, decoded);
-            progress -= size;
-            printf("%s - %f%% (%lu + %lu - %lu / %lu, %lu)\n", decoded, (100.0 * progress) / solver_instance->n_hidden, total, branch_nodes[i].node->total, size, beta, n_test);
+            scheduler_join(&tasks[i].task);
         }
-
-        total += branch_nodes[i].node->total - size;
+        free(tasks);
     }
-    return total;
+    else
+    {
+        for (size_t i = branch->count; (i-- > 0) && solve_branch(&job, i, solver_instance->test_vector);)
+        {
+        }
+    }
+    return atomic_load(&job.failed) ? UINTMAX_MAX : atomic_load(&job.total);
 }
 
-size_t optimize_beta(const WordleSolverInstance *solver_instance, Branch *branch, WordleNode *node, const float progress, size_t beta)
+size_t optimize_beta(const WordleSolverInstance *solver_instance, Branch *branch, WordleNode *node, const float progress, size_t beta,
+                     CandidateJob *candidates, size_t candidate)
 {
     if (solver_instance->depth < LOG_DEPTH)
     {
@@ -161,8 +350,8 @@ size_t optimize_beta(const WordleSolverInstance *solver_instance, Branch *branch
     }
 
     create_branches(solver_instance, branch);
-    WordleBranch *branch_nodes = calloc(branch->count, sizeof(*branch_nodes));
-    size_t total = sum_branch_total(solver_instance, branch, beta, branch_nodes);
+    WordleBranch *branch_nodes = arena_alloc(branch->count * sizeof(*branch_nodes));
+    size_t total = sum_branch_total(solver_instance, branch, beta, branch_nodes, candidates, candidate);
 
     if (beta > total)
     {
@@ -174,45 +363,183 @@ size_t optimize_beta(const WordleSolverInstance *solver_instance, Branch *branch
         beta = total;
         node->test_index = branch->test_index;
         node->total = total;
-        free(node->branches);
+        release_branches(node->branches, node->num_branches);
         node->num_branches = branch->count;
         node->branches = branch_nodes;
     }
     else
     {
-        free(branch_nodes);
+        release_branches(branch_nodes, branch->count);
     }
     return beta;
 }
 
-WordleNode *_optimize(const WordleSolverInstance *solver_instance, size_t beta)
+typedef struct CandidateTask
 {
-    WordleNode *node = calloc(1, sizeof(*node));
-    node->total = UINTMAX_MAX;
+    Task task;
+    CandidateJob *job;
+    size_t i;
+    index_t *test_vector;
+} CandidateTask;
 
-    const size_t n_hidden = solver_instance->n_hidden;
-    const size_t n_test = solver_instance->n_test;
-    size_t pruned_index;
-    bool prune = false;
-    size_t hidden_indicies[n_hidden];
-    Branch branch = {
-        .hidden_indicies = hidden_indicies,
+void evaluate_candidate(CandidateJob *job, size_t i, index_t *test_vector)
+{
+    const WordleSolverInstance *node_instance = job->solver_instance;
+    SolverContext *context = solver_context();
+    // the node's tile is only read, everything below it goes to this worker's buffers
+    const WordleSolverInstance solver_instance = {
+        .wordle_instance = node_instance->wordle_instance,
+        .n_hidden = node_instance->n_hidden,
+        .hidden_vector = node_instance->hidden_vector,
+        .n_test = node_instance->n_test,
+        .test_vector = test_vector,
+        .test_values = context->test_values,
+        .score_cache = node_instance->score_cache,
+        .parent_scores = node_instance->parent_scores,
+        .parent_n_hidden = node_instance->parent_n_hidden,
+        .columns = node_instance->columns,
+        .packed_scores = node_instance->packed_scores,
+        .partition_table = &context->partition_table,
+        .fingerprint = node_instance->fingerprint,
+        .test_set = node_instance->test_set,
+        .depth = node_instance->depth,
     };
+    // the node itself does not branch while its candidates are searched, so they can take its depth's partition
+    Branch *branch = &context->branches[node_instance->depth];
+    branch->test_index = job->test_ordering[i].index;
+    WordleNode *candidate = &job->candidates[i];
+    candidate->total = UINTMAX_MAX;
+    optimize_beta(&solver_instance, branch, candidate, (1.0 + i) / SEARCH_DEPTH, job->beta, job, i);
+    if (candidate->total == UINTMAX_MAX)
+    {
+        return;
+    }
+    uint64_t packed = (uint64_t)candidate->total * SEARCH_DEPTH + i;
+    uint64_t best = atomic_load(&job->best);
+    while (packed < best && !atomic_compare_exchange_weak(&job->best, &best, packed))
+    {
+    }
+    // the loser's subtrees go right away instead of once every candidate is done, a candidate is
+    // displaced at most once as the best only decreases, so exactly one thread releases it
+    WordleNode *loser = packed > best ? candidate : (best != UINT64_MAX ? &job->candidates[best % SEARCH_DEPTH] : NULL);
+    if (loser != NULL)
+    {
+        release_branches(loser->branches, loser->num_branches);
+        loser->branches = NULL;
+        loser->num_branches = 0;
+    }
+}
+
+void run_candidate_task(Task *task)
+{
+    CandidateTask *candidate_task = (CandidateTask *)task;
+    evaluate_candidate(candidate_task->job, candidate_task->i, candidate_task->test_vector);
+    free_test_vector(candidate_task->job->solver_instance, candidate_task->test_vector);
+}
+
+size_t optimize_candidates(const WordleSolverInstance *solver_instance, const tuple *test_ordering, size_t n_candidates, WordleNode *node, size_t beta)
+{
+    // candidates are independent, every one prunes against the best total found so far
+    CandidateJob job = {
+        .solver_instance = solver_instance,
+        .test_ordering = test_ordering,
+        .beta = beta,
+        .best = UINT64_MAX,
+        .candidates = calloc(n_candidates, sizeof(WordleNode)),
+    };
+    // the best ranked candidate runs here and sets the first bound, thieves take the next best ones
+    CandidateTask *tasks = calloc(n_candidates, sizeof(*tasks));
+    for (size_t i = 1; i < n_candidates; i++)
+    {
+        tasks[i].task.run = run_candidate_task;
+        tasks[i].job = &job;
+        tasks[i].i = i;
+        tasks[i].test_vector = copy_test_vector(solver_instance);
+        scheduler_spawn(&tasks[i].task);
+    }
+    evaluate_candidate(&job, 0, solver_instance->test_vector);
+    for (size_t i = n_candidates; i-- > 1;)
+    {
+        scheduler_join(&tasks[i].task);
+    }
+    free(tasks);
+
+    // the outcome only depends on the ranking: lowest total, ties go to the better ranked candidate,
+    // every other candidate was released when it lost
+    uint64_t best = atomic_load(&job.best);
+    if (best != UINT64_MAX)
+    {
+        WordleNode *candidate = &job.candidates[best % SEARCH_DEPTH];
+        node->test_index = candidate->test_index;
+        node->total = candidate->total;
+        node->num_branches = candidate->num_branches;
+        node->branches = candidate->branches;
+        beta = candidate->total;
+    }
+    free(job.candidates);
+    return beta;
+}
 
+WordleNode *_optimize(const WordleSolverInstance *parent_instance, size_t beta)
+{
+    const size_t n_hidden = parent_instance->n_hidden;
     // max recursion depth or beta too small (smallest tree needs at least 2n-1 total tries)
-    if (n_hidden == 0 || solver_instance->depth >= 10 || beta <= (2 * n_hidden - 1))
+    if (n_hidden == 0 || parent_instance->depth >= MAX_DEPTH || beta <= (2 * n_hidden - 1))
     {
-        free(node);
         return NULL;
     }
+
+    WordleNode *node = arena_alloc(sizeof(*node));
+    node->total = UINTMAX_MAX;
     if (n_hidden == 1)
     {
-        node->test_index = solver_instance->hidden_vector[0];
+        node->test_index = parent_instance->hidden_vector[0];
         node->total = 1;
         node->num_branches = 0;
         return node;
     }
 
+    // pass on only one test word per letter relevance class, children keep the reduced set
+    // hard mode did so already before looking up the memo
+    bool compress = n_hidden > 2 && !parent_instance->wordle_instance->hard_mode;
+    const size_t n_test = compress ? compress_test_vector(parent_instance) : parent_instance->n_test;
+
+    // hard mode children filter the allowed test words of this node, gathered once for all of them
+    uint64_t *test_set = NULL;
+    if (parent_instance->wordle_instance->hard_mode)
+    {
+        test_set = solver_context()->test_sets[parent_instance->depth];
+        memset(test_set, 0, filter_index.n_words * sizeof(uint64_t));
+        for (size_t i = 0; i < n_test; i++)
+        {
+            test_set[parent_instance->test_vector[i] / 64] |= 1LU << (parent_instance->test_vector[i] % 64);
+        }
+    }
+
+    // small nodes pack their score columns while ranking, the tile is then used for branching and by children
+    bool pack = n_hidden > 2 && n_hidden <= PACK_MAX_HIDDEN;
+    const WordleSolverInstance node_instance = {
+        .wordle_instance = parent_instance->wordle_instance,
+        .n_hidden = n_hidden,
+        .hidden_vector = parent_instance->hidden_vector,
+        .n_test = n_test,
+        .test_vector = parent_instance->test_vector,
+        .test_values = parent_instance->test_values,
+        .score_cache = parent_instance->score_cache,
+        .parent_scores = parent_instance->parent_scores,
+        .parent_n_hidden = parent_instance->parent_n_hidden,
+        .columns = parent_instance->columns,
+        .packed_scores = pack ? packed_buffer(parent_instance->wordle_instance, parent_instance->depth, n_hidden) : NULL,
+        .partition_table = parent_instance->partition_table,
+        .fingerprint = parent_instance->fingerprint,
+        .test_set = test_set,
+        .depth = parent_instance->depth,
+    };
+    const WordleSolverInstance *solver_instance = &node_instance;
+    size_t pruned_index;
+    bool prune = false;
+    Branch *branch = &solver_context()->branches[solver_instance->depth];
+
     if (n_hidden == 2)
     {
         prune = true;
@@ -227,8 +554,8 @@ WordleNode *_optimize(const WordleSolverInstance *solver_instance, size_t beta)
     if (prune)
     {
         // prune if wordle is solvable with at most two guesses
-        branch.test_index = pruned_index;
-        beta = optimize_beta(solver_instance, &branch, node, 1.0, beta);
+        branch->test_index = pruned_index;
+        beta = optimize_beta(solver_instance, branch, node, 1.0, beta, NULL, 0);
     }
     else
     {
@@ -236,53 +563,88 @@ WordleNode *_optimize(const WordleSolverInstance *solver_instance, size_t beta)
         tuple test_ordering[SEARCH_DEPTH];
         for (size_t i = 0; i < n_test && i < SEARCH_DEPTH; i++)
         {
-            test_ordering[i].index = solver_instance->test_vector[i].index;
-            test_ordering[i].value = solver_instance->test_vector[i].value;
+            test_ordering[i].index = solver_instance->test_vector[i];
+            test_ordering[i].value = solver_instance->test_values[i];
         }
         double min_entropy = SEARCH_ENTROPY_DEPTH * test_ordering[0].value;
-        for (size_t i = 0; i < n_test && i < SEARCH_DEPTH; i++)
+        size_t n_candidates = 0;
+        while (n_candidates < n_test && n_candidates < SEARCH_DEPTH && test_ordering[n_candidates].value >= min_entropy)
         {
-            if (test_ordering[i].value < min_entropy)
+            n_candidates++;
+        }
+        if (spawn_tasks(solver_instance) && n_candidates > 1)
+        {
+            beta = optimize_candidates(solver_instance, test_ordering, n_candidates, node, beta);
+        }
+        else
+        {
+            for (size_t i = 0; i < n_candidates; i++)
             {
-                break;
+                branch->test_index = test_ordering[i].index;
+                beta = optimize_beta(solver_instance, branch, node, (1.0 + i) / SEARCH_DEPTH, beta, NULL, 0);
             }
-            branch.test_index = test_ordering[i].index;
-            beta = optimize_beta(solver_instance, &branch, node, (1.0 + i) / SEARCH_DEPTH, beta);
         }
     }
 
     if (node->total == UINTMAX_MAX)
     {
-        free(node);
+        arena_free(node, sizeof(*node));
         return NULL;
     }
     return node;
 }
 
-WordleNode *optimize(const WordleSolverInstance *solver_instance, size_t beta)
+WordleNode *optimize(const WordleSolverInstance *parent_instance, size_t beta)
 {
     WordleNode *node;
 
-    hasmap_key_t *key = NULL;
-    if (!solver_instance->wordle_instance->hard_mode)
+    // hard mode subsets are keyed on the test words their path allows, only one per relevance class of them
+    // matters and _optimize keeps the same ones, so compressing first lets more paths share an entry
+    bool hard_mode = parent_instance->wordle_instance->hard_mode;
+    const WordleSolverInstance node_instance = {
+        .wordle_instance = parent_instance->wordle_instance,
+        .n_hidden = parent_instance->n_hidden,
+        .hidden_vector = parent_instance->hidden_vector,
+        .n_test = hard_mode ? compress_test_vector(parent_instance) : parent_instance->n_test,
+        .test_vector = parent_instance->test_vector,
+        .test_values = parent_instance->test_values,
+        .score_cache = parent_instance->score_cache,
+        .parent_scores = parent_instance->parent_scores,
+        .parent_n_hidden = parent_instance->parent_n_hidden,
+        .columns = parent_instance->columns,
+        .packed_scores = parent_instance->packed_scores,
+        .partition_table = parent_instance->partition_table,
+        .fingerprint = parent_instance->fingerprint,
+        .depth = parent_instance->depth,
+    };
+    const WordleSolverInstance *solver_instance = &node_instance;
+
+    // waits while another thread solves the same subset
+    hasmap_key_t lookup_key;
+    MemoClaim claim;
+    init_lookup_key(&lookup_key, solver_instance);
+    node = solver_hashmap_claim(&lookup_key, &claim);
+    if (node != NULL)
     {
-        key = get_key(solver_instance);
-        node = solver_hashmap_get(key);
-        if (node != NULL)
-        {
-            return node;
-        }
+        return node;
     }
 
-    clock_t start = clock();
+    // wall time, clock() would add up the cpu time of all threads
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     node = _optimize(solver_instance, beta);
 
     if (node != NULL)
     {
+        // the caller owns the returned reference, memo hits are retained for it as well
+        atomic_init(&node->refs, 1);
         // save stats
-        node->duration = (float)(clock() - start) / CLOCKS_PER_SEC;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        node->duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
         node->n_hidden = solver_instance->n_hidden;
-        node->n_test = solver_instance->n_test;
+        // the same for every path sharing the entry: all test words in normal mode, in hard mode the relevance
+        // classes the entry is keyed on, except at the root where every test word is allowed
+        node->n_test = hard_mode && solver_instance->depth > 0 ? solver_instance->n_test : solver_instance->wordle_instance->n_test;
         node->average_case = (float)node->total / node->n_hidden;
         if (node->num_branches == 0 && node->n_hidden > 0)
         {
@@ -308,51 +670,119 @@ WordleNode *optimize(const WordleSolverInstance *solver_instance, size_t beta)
                 }
             }
         }
-        if (!solver_instance->wordle_instance->hard_mode)
+        node->key = get_key(&lookup_key);
+        node = solver_hashmap_put(&claim, node);
+    }
+    else
+    {
+        solver_hashmap_release(&claim);
+    }
+    return node;
+}
+
+void init_solver_contexts(const WordleInstance *wordle_instance)
+{
+    solver_contexts = calloc(scheduler_workers(), sizeof(*solver_contexts));
+    for (size_t t = 0; t < scheduler_workers(); t++)
+    {
+        for (size_t i = 0; i < MAX_DEPTH; i++)
+        {
+            solver_contexts[t].branches[i].hidden_indicies = malloc(wordle_instance->n_hidden * sizeof(index_t));
+            solver_contexts[t].branches[i].columns = malloc(wordle_instance->n_hidden * sizeof(index_t));
+        }
+        init_partition_table(&solver_contexts[t].partition_table, wordle_instance->n_test);
+        solver_contexts[t].test_values = malloc(wordle_instance->n_test * sizeof(double));
+        if (wordle_instance->hard_mode)
         {
-            node->key = key;
-            solver_hashmap_put(key, node);
+            for (size_t i = 0; i < MAX_DEPTH; i++)
+            {
+                solver_contexts[t].test_sets[i] = malloc(filter_index.n_words * sizeof(uint64_t));
+            }
+            for (size_t i = 0; i <= MAX_DEPTH; i++)
+            {
+                solver_contexts[t].test_buffers[i] = malloc(wordle_instance->n_test * sizeof(index_t));
+            }
         }
     }
-    else if (!solver_instance->wordle_instance->hard_mode)
+}
+
+void free_solver_contexts()
+{
+    for (size_t t = 0; t < scheduler_workers(); t++)
     {
-        free(key);
+        for (size_t i = 0; i < MAX_DEPTH; i++)
+        {
+            free(solver_contexts[t].packed_buffers[i]);
+            free(solver_contexts[t].branches[i].hidden_indicies);
+            free(solver_contexts[t].branches[i].columns);
+        }
+        free_partition_table(&solver_contexts[t].partition_table);
+        free(solver_contexts[t].test_values);
+        for (size_t i = 0; i < MAX_DEPTH; i++)
+        {
+            free(solver_contexts[t].test_sets[i]);
+        }
+        for (size_t i = 0; i <= MAX_DEPTH; i++)
+        {
+            free(solver_contexts[t].test_buffers[i]);
+        }
     }
-    return node;
+    free(solver_contexts);
+    solver_contexts = NULL;
 }
 
 void optimize_decision_tree(const WordleInstance *wordle_instance, char *file_name)
 {
-    // initialize hidden vector indices
-    size_t hidden_vector[wordle_instance->n_hidden];
+    // initialize hidden vector indices, on the heap as a full dictionary would crowd the stack
+    index_t *hidden_vector = malloc(wordle_instance->n_hidden * sizeof(*hidden_vector));
     for (size_t i = 0; i < wordle_instance->n_hidden; i++)
     {
         hidden_vector[i] = i;
     }
     // initialize test vector indices
-    tuple test_vector[wordle_instance->n_test];
+    index_t *test_vector = malloc(wordle_instance->n_test * sizeof(*test_vector));
     for (size_t i = 0; i < wordle_instance->n_test; i++)
     {
-        test_vector[i].index = i;
+        test_vector[i] = i;
     }
+    ScoreCache score_cache;
+    load_score_cache(wordle_instance, &score_cache);
+    init_entropy_table(wordle_instance->n_hidden);
+    init_fingerprint_table(wordle_instance->n_hidden, wordle_instance->n_test);
+    if (wordle_instance->hard_mode)
+    {
+        init_filter_index(wordle_instance);
+    }
+    scheduler_init(resolve_threads(wordle_instance->n_threads));
+    init_solver_contexts(wordle_instance);
     WordleSolverInstance solver_instance = {
         .wordle_instance = wordle_instance,
         .n_hidden = wordle_instance->n_hidden,
         .hidden_vector = hidden_vector,
         .n_test = wordle_instance->n_test,
         .test_vector = test_vector,
-        .score_cache = (const uint8_t **)populate_score_cache(wordle_instance),
+        .test_values = solver_contexts[0].test_values,
+        .score_cache = &score_cache,
+        .columns = hidden_vector,
+        .partition_table = &solver_contexts[0].partition_table,
+        .fingerprint = subset_fingerprint(hidden_vector, wordle_instance->n_hidden),
         .depth = 0,
     };
-    if (!wordle_instance->hard_mode)
-    {
-        solver_hashmap_init();
-    }
+    solver_hashmap_init(MEMO_EXPECTED_ENTRIES(wordle_instance->n_hidden), wordle_instance->memo_budget,
+                        wordle_instance->memo_spill_file);
     WordleNode *decision_tree = optimize(&solver_instance, UINTMAX_MAX);
+    free_solver_contexts();
+    scheduler_shutdown();
     save_node(file_name, wordle_instance, decision_tree);
-    if (!wordle_instance->hard_mode)
-    {
-        solver_hashmap_cleanup();
-    }
-    free(solver_instance.score_cache);
+    // the tree and the memo go with the arena instead of node by node
+    solver_hashmap_cleanup();
+    print_arena_usage();
+    arena_reset();
+    free_entropy_table();
+    free_fingerprint_table();
+    free_filter_index();
+    print_score_cache_usage(&score_cache);
+    free_score_cache(&score_cache);
+    free(hidden_vector);
+    free(test_vector);
 }
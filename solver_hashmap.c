@@ -1,69 +1,578 @@
 #include "solver_hashmap.h"
+#include "arena.h"
+#include "memo_spill.h"
+#include <pthread.h>
+#include <stdio.h>
 #include <string.h>
 
-HASHMAP(hasmap_key_t, WordleNode)
-solver_hashmap;
+// marks a slot whose node was evicted, lookups probe past it and inserts reuse it
+#define MEMO_TOMBSTONE ((WordleNode *)1)
+
+// one cache line, fingerprints are checked before any node is touched
+typedef struct MemoBucket
+{
+    uint64_t fingerprints[MEMO_BUCKET_SLOTS];
+    WordleNode *nodes[MEMO_BUCKET_SLOTS];
+} __attribute__((aligned(64))) MemoBucket;
+
+// evicted subset written to the spill log, offset 0 marks an empty slot
+typedef struct SpillSlot
+{
+    uint64_t fingerprint;
+    size_t offset;
+} SpillSlot;
+
+typedef struct MemoStripe
+{
+    pthread_mutex_t lock;
+    // signalled whenever a claim on this stripe is released
+    pthread_cond_t released;
+    // subsets some thread is solving right now
+    MemoClaim *claims;
+    // open addressing over buckets, slots fill up in order and evicted entries leave a tombstone
+    MemoBucket *buckets;
+    size_t n_buckets;
+    size_t n_entries;
+    size_t n_tombstones;
+    // xorshift state, picks where eviction samples start
+    uint64_t eviction_state;
+    // open addressing index of the spilled subsets, the nodes themselves are on disk
+    SpillSlot *spill_slots;
+    size_t n_spill_slots;
+    size_t n_spilled;
+} MemoStripe;
+
+MemoStripe solver_hashmap[MEMO_STRIPES];
+size_t memo_budget = 0;
+atomic_size_t memo_bytes = 0;
+
+size_t key_words(size_t n_hidden)
+{
+    return n_hidden <= KEY_LIST_MAX ? (n_hidden * sizeof(index_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t) : KEY_WORDS;
+}
+
+size_t test_key_words(size_t n_test)
+{
+    return n_test <= TEST_KEY_LIST_MAX ? (n_test * sizeof(index_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t) : TEST_KEY_WORDS;
+}
+
+size_t key_size(const hasmap_key_t *key)
+{
+    return sizeof(*key) + (key_words(key->n_hidden) + test_key_words(key->n_test)) * sizeof(uint64_t);
+}
+
+int compare_indices(const void *a, const void *b)
+{
+    return (int)*(const index_t *)a - (int)*(const index_t *)b;
+}
+
+bool hidden_matches(const hasmap_key_t *key, const index_t *hidden_vector)
+{
+    // a stored index list has the layout of a hidden vector
+    if (key->hidden_vector != NULL || key->n_hidden <= KEY_LIST_MAX)
+    {
+        const index_t *indices = key->hidden_vector != NULL ? key->hidden_vector : (const index_t *)key->words;
+        return memcmp(indices, hidden_vector, key->n_hidden * sizeof(index_t)) == 0;
+    }
+    // equal sizes, so every word being in the bitset means equal sets
+    for (size_t i = 0; i < key->n_hidden; i++)
+    {
+        if (!(key->words[hidden_vector[i] / 64] & (1LU << (hidden_vector[i] % 64))))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_matches(const hasmap_key_t *key, const index_t *test_vector)
+{
+    // stored keys only, the test words of a lookup key are in no particular order
+    const uint64_t *words = key->words + key_words(key->n_hidden);
+    for (size_t i = 0; i < key->n_test; i++)
+    {
+        index_t index = test_vector[i];
+        bool found = key->n_test <= TEST_KEY_LIST_MAX
+                         ? bsearch(&index, words, key->n_test, sizeof(index_t), compare_indices) != NULL
+                         : (words[index / 64] & (1LU << (index % 64))) != 0;
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool key_matches(const hasmap_key_t *key, const hasmap_key_t *lookup_key)
+{
+    if (!hidden_matches(key, lookup_key->hidden_vector))
+    {
+        return false;
+    }
+    // two lookup keys only meet in the claim list, their owners reorder the test words meanwhile,
+    // so they are not compared there and a fingerprint collision merely makes a thread wait
+    return key->hidden_vector != NULL || test_matches(key, lookup_key->test_vector);
+}
 
 int compare(const hasmap_key_t *k1, const hasmap_key_t *k2)
 {
-    for (size_t i = 0; i < KEY_SIZE; i++)
+    if (k1->fingerprint != k2->fingerprint)
+    {
+        return k1->fingerprint < k2->fingerprint ? -1 : 1;
+    }
+    if (k1->n_hidden != k2->n_hidden)
+    {
+        return k1->n_hidden < k2->n_hidden ? -1 : 1;
+    }
+    if (k1->n_test != k2->n_test)
+    {
+        return k1->n_test < k2->n_test ? -1 : 1;
+    }
+    // equal fingerprints almost always mean equal subsets, only verify
+    if (k1->hidden_vector != NULL)
+    {
+        return key_matches(k2, k1) ? 0 : 1;
+    }
+    if (k2->hidden_vector != NULL)
+    {
+        return key_matches(k1, k2) ? 0 : -1;
+    }
+    return memcmp(k1->words, k2->words, key_size(k1) - sizeof(*k1));
+}
+
+MemoBucket *allocate_buckets(size_t n_buckets)
+{
+    MemoBucket *buckets = aligned_alloc(sizeof(MemoBucket), n_buckets * sizeof(MemoBucket));
+    memset(buckets, 0, n_buckets * sizeof(MemoBucket));
+    return buckets;
+}
+
+WordleNode *retain_node(WordleNode *node)
+{
+    atomic_fetch_add_explicit(&node->refs, 1, memory_order_relaxed);
+    return node;
+}
+
+void release_node(WordleNode *node)
+{
+    if (node == NULL || atomic_fetch_sub_explicit(&node->refs, 1, memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+    release_branches(node->branches, node->num_branches);
+    arena_free(node->key, key_size(node->key));
+    arena_free(node, sizeof(*node));
+}
+
+void release_branches(WordleBranch *branches, size_t num_branches)
+{
+    // branches of a discarded search may be partially filled
+    for (size_t i = 0; branches != NULL && i < num_branches; i++)
+    {
+        release_node(branches[i].node);
+    }
+    arena_free(branches, num_branches * sizeof(*branches));
+}
+
+size_t node_bytes(const WordleNode *node)
+{
+    // children are shared and accounted for by their own entries, faulted back ones included
+    return sizeof(*node) + node->num_branches * sizeof(WordleBranch) + key_size(node->key);
+}
+
+double eviction_cost(const WordleNode *node)
+{
+    return node->duration + MEMO_HIDDEN_COST * node->n_hidden;
+}
+
+void solver_hashmap_init(size_t expected_entries, size_t budget, const char *spill_file)
+{
+    // size the stripes so that the expected entries stay below the maximum load
+    size_t n_buckets = 1;
+    while (n_buckets * MEMO_BUCKET_SLOTS * MEMO_STRIPES * 3 < expected_entries * 4)
+    {
+        n_buckets *= 2;
+    }
+    for (size_t i = 0; i < MEMO_STRIPES; i++)
+    {
+        pthread_mutex_init(&solver_hashmap[i].lock, NULL);
+        pthread_cond_init(&solver_hashmap[i].released, NULL);
+        solver_hashmap[i].claims = NULL;
+        solver_hashmap[i].buckets = allocate_buckets(n_buckets);
+        solver_hashmap[i].n_buckets = n_buckets;
+        solver_hashmap[i].n_entries = 0;
+        solver_hashmap[i].n_tombstones = 0;
+        solver_hashmap[i].eviction_state = i + 1;
+        solver_hashmap[i].spill_slots = NULL;
+        solver_hashmap[i].n_spill_slots = 0;
+        solver_hashmap[i].n_spilled = 0;
+    }
+    memo_budget = budget;
+    atomic_store(&memo_bytes, 0);
+    // without a budget nothing is evicted, so there is nothing to spill either
+    if (budget > 0 && spill_file != NULL && !memo_spill_open(spill_file))
+    {
+        printf("Could not open memo spill file %s!\n", spill_file);
+    }
+}
+
+WordleNode *find_node(const MemoStripe *stripe, const hasmap_key_t *key)
+{
+    // caller holds the stripe lock
+    for (size_t b = key->fingerprint & (stripe->n_buckets - 1);; b = (b + 1) & (stripe->n_buckets - 1))
     {
-        int diff = (*k1)[i] - (*k2)[i];
-        if (diff != 0)
+        const MemoBucket *bucket = &stripe->buckets[b];
+        for (size_t slot = 0; slot < MEMO_BUCKET_SLOTS; slot++)
         {
-            return diff;
+            if (bucket->nodes[slot] == NULL)
+            {
+                return NULL;
+            }
+            if (bucket->nodes[slot] != MEMO_TOMBSTONE && bucket->fingerprints[slot] == key->fingerprint &&
+                compare(bucket->nodes[slot]->key, key) == 0)
+            {
+                return bucket->nodes[slot];
+            }
+        }
+    }
+}
+
+void insert_node(MemoBucket *buckets, size_t n_buckets, WordleNode *node)
+{
+    uint64_t fingerprint = node->key->fingerprint;
+    for (size_t b = fingerprint & (n_buckets - 1);; b = (b + 1) & (n_buckets - 1))
+    {
+        for (size_t slot = 0; slot < MEMO_BUCKET_SLOTS; slot++)
+        {
+            if (buckets[b].nodes[slot] == NULL || buckets[b].nodes[slot] == MEMO_TOMBSTONE)
+            {
+                buckets[b].fingerprints[slot] = fingerprint;
+                buckets[b].nodes[slot] = node;
+                return;
+            }
+        }
+    }
+}
+
+void rebuild_stripe(MemoStripe *stripe, size_t n_buckets)
+{
+    // tombstones are dropped on the way
+    MemoBucket *buckets = allocate_buckets(n_buckets);
+    for (size_t b = 0; b < stripe->n_buckets; b++)
+    {
+        for (size_t slot = 0; slot < MEMO_BUCKET_SLOTS && stripe->buckets[b].nodes[slot] != NULL; slot++)
+        {
+            if (stripe->buckets[b].nodes[slot] != MEMO_TOMBSTONE)
+            {
+                insert_node(buckets, n_buckets, stripe->buckets[b].nodes[slot]);
+            }
+        }
+    }
+    free(stripe->buckets);
+    stripe->buckets = buckets;
+    stripe->n_buckets = n_buckets;
+    stripe->n_tombstones = 0;
+}
+
+void index_spilled(MemoStripe *stripe, uint64_t fingerprint, size_t offset)
+{
+    // caller holds the stripe lock
+    if (4 * (stripe->n_spilled + 1) > 3 * stripe->n_spill_slots)
+    {
+        size_t n_slots = stripe->n_spill_slots > 0 ? 2 * stripe->n_spill_slots : 64;
+        SpillSlot *slots = calloc(n_slots, sizeof(*slots));
+        for (size_t i = 0; i < stripe->n_spill_slots; i++)
+        {
+            SpillSlot slot = stripe->spill_slots[i];
+            if (slot.offset == 0)
+            {
+                continue;
+            }
+            size_t s = slot.fingerprint & (n_slots - 1);
+            while (slots[s].offset != 0)
+            {
+                s = (s + 1) & (n_slots - 1);
+            }
+            slots[s] = slot;
+        }
+        free(stripe->spill_slots);
+        stripe->spill_slots = slots;
+        stripe->n_spill_slots = n_slots;
+    }
+    size_t s = fingerprint & (stripe->n_spill_slots - 1);
+    while (stripe->spill_slots[s].offset != 0)
+    {
+        // a node read back from the log keeps its record and is not indexed twice
+        if (stripe->spill_slots[s].offset == offset)
+        {
+            return;
+        }
+        s = (s + 1) & (stripe->n_spill_slots - 1);
+    }
+    stripe->spill_slots[s].fingerprint = fingerprint;
+    stripe->spill_slots[s].offset = offset;
+    stripe->n_spilled++;
+}
+
+size_t find_spilled(const MemoStripe *stripe, const hasmap_key_t *key)
+{
+    // caller holds the stripe lock
+    for (size_t s = key->fingerprint & (stripe->n_spill_slots - 1); stripe->spill_slots[s].offset != 0;
+         s = (s + 1) & (stripe->n_spill_slots - 1))
+    {
+        if (stripe->spill_slots[s].fingerprint == key->fingerprint &&
+            compare(memo_spill_key(stripe->spill_slots[s].offset), key) == 0)
+        {
+            return stripe->spill_slots[s].offset;
         }
     }
     return 0;
 }
 
-size_t hash(const hasmap_key_t *key)
+bool evict_node(MemoStripe *stripe, const WordleNode *keep)
+{
+    // caller holds the stripe lock, sampled from a random bucket on as the stripe is not ordered by cost
+    stripe->eviction_state ^= stripe->eviction_state << 13;
+    stripe->eviction_state ^= stripe->eviction_state >> 7;
+    stripe->eviction_state ^= stripe->eviction_state << 17;
+    size_t start = stripe->eviction_state & (stripe->n_buckets - 1);
+    MemoBucket *victim_bucket = NULL;
+    size_t victim_slot = 0;
+    size_t n_sampled = 0;
+    for (size_t n = 0; n < stripe->n_buckets && n_sampled < MEMO_EVICTION_SAMPLES; n++)
+    {
+        MemoBucket *bucket = &stripe->buckets[(start + n) & (stripe->n_buckets - 1)];
+        for (size_t slot = 0; slot < MEMO_BUCKET_SLOTS && bucket->nodes[slot] != NULL; slot++)
+        {
+            WordleNode *node = bucket->nodes[slot];
+            if (node == MEMO_TOMBSTONE || node == keep)
+            {
+                continue;
+            }
+            n_sampled++;
+            if (victim_bucket == NULL || eviction_cost(node) < eviction_cost(victim_bucket->nodes[victim_slot]))
+            {
+                victim_bucket = bucket;
+                victim_slot = slot;
+            }
+        }
+    }
+    if (victim_bucket == NULL)
+    {
+        return false;
+    }
+    WordleNode *victim = victim_bucket->nodes[victim_slot];
+    victim_bucket->nodes[victim_slot] = MEMO_TOMBSTONE;
+    stripe->n_entries--;
+    stripe->n_tombstones++;
+    atomic_fetch_sub(&memo_bytes, node_bytes(victim));
+    size_t offset = memo_spill_enabled() ? memo_spill_write(victim) : 0;
+    if (offset != 0)
+    {
+        index_spilled(stripe, victim->key->fingerprint, offset);
+    }
+    // trees that still use the node keep it alive
+    release_node(victim);
+    return true;
+}
+
+MemoStripe *memo_stripe(const hasmap_key_t *key)
 {
-    return hashmap_hash_default(*key, KEY_SIZE * sizeof(bool));
+    return &solver_hashmap[(key->fingerprint >> 32) % MEMO_STRIPES];
 }
 
-void solver_hashmap_init()
+void init_lookup_key(hasmap_key_t *key, const WordleSolverInstance *solver_instance)
 {
-    hashmap_init(&solver_hashmap, hash, compare);
+    key->fingerprint = solver_instance->fingerprint;
+    key->n_hidden = solver_instance->n_hidden;
+    key->hidden_vector = solver_instance->hidden_vector;
+    key->n_test = 0;
+    key->test_vector = NULL;
+    // hard mode subsets are solved with the test words the path to them allows
+    if (solver_instance->wordle_instance->hard_mode)
+    {
+        key->n_test = solver_instance->n_test;
+        key->test_vector = solver_instance->test_vector;
+        key->fingerprint += test_set_fingerprint(solver_instance->test_vector, solver_instance->n_test);
+    }
 }
 
-hasmap_key_t *get_key(const WordleSolverInstance *solver_instance)
+hasmap_key_t *get_key(const hasmap_key_t *lookup_key)
 {
-    hasmap_key_t *key = calloc(1, sizeof(*key));
-    for (size_t i = 0; i < solver_instance->n_hidden; i++)
+    // only built for inserts, hidden vectors are ascending so the index list is already sorted
+    size_t n_hidden = lookup_key->n_hidden;
+    size_t n_test = lookup_key->n_test;
+    hasmap_key_t *key = arena_alloc(sizeof(*key) + (key_words(n_hidden) + test_key_words(n_test)) * sizeof(uint64_t));
+    key->fingerprint = lookup_key->fingerprint;
+    key->n_hidden = n_hidden;
+    key->n_test = n_test;
+    if (n_hidden <= KEY_LIST_MAX)
     {
-        (*key)[solver_instance->hidden_vector[i]] = true;
+        memcpy(key->words, lookup_key->hidden_vector, n_hidden * sizeof(index_t));
+    }
+    else
+    {
+        for (size_t i = 0; i < n_hidden; i++)
+        {
+            index_t index = lookup_key->hidden_vector[i];
+            key->words[index / 64] |= 1LU << (index % 64);
+        }
+    }
+    uint64_t *test_words = key->words + key_words(n_hidden);
+    if (n_test > TEST_KEY_LIST_MAX)
+    {
+        for (size_t i = 0; i < n_test; i++)
+        {
+            index_t index = lookup_key->test_vector[i];
+            test_words[index / 64] |= 1LU << (index % 64);
+        }
+    }
+    else if (n_test > 0)
+    {
+        // test words are ordered by rank, the list has to be sorted
+        memcpy(test_words, lookup_key->test_vector, n_test * sizeof(index_t));
+        qsort(test_words, n_test, sizeof(index_t), compare_indices);
     }
     return key;
 }
 
-WordleNode *solver_hashmap_get(const hasmap_key_t *key)
+WordleNode *store_node(MemoStripe *stripe, WordleNode *node)
 {
-    return hashmap_get(&solver_hashmap, key);
+    // caller holds the stripe lock, the memo takes its own reference.
+    // a subset that is already stored keeps its entry, so no node is charged to the budget twice
+    WordleNode *stored = find_node(stripe, node->key);
+    if (stored != NULL)
+    {
+        return stored;
+    }
+    if (4 * (stripe->n_entries + stripe->n_tombstones + 1) > 3 * MEMO_BUCKET_SLOTS * stripe->n_buckets)
+    {
+        // only grow if live entries fill more than half of the maximum load, otherwise clearing tombstones is enough
+        bool grow = 8 * (stripe->n_entries + 1) > 3 * MEMO_BUCKET_SLOTS * stripe->n_buckets;
+        rebuild_stripe(stripe, grow ? 2 * stripe->n_buckets : stripe->n_buckets);
+    }
+    insert_node(stripe->buckets, stripe->n_buckets, retain_node(node));
+    stripe->n_entries++;
+    size_t bytes = atomic_fetch_add(&memo_bytes, node_bytes(node)) + node_bytes(node);
+    // every stripe evicts for its own inserts, so the memo as a whole stays close to the budget
+    while (memo_budget > 0 && bytes > memo_budget && evict_node(stripe, node))
+    {
+        bytes = atomic_load(&memo_bytes);
+    }
+    return node;
 }
 
-void solver_hashmap_put(const hasmap_key_t *key, WordleNode *node)
+WordleNode *fault_node(MemoClaim *claim, size_t offset);
+
+WordleNode *resolve_spilled(size_t offset)
 {
-    hashmap_put(&solver_hashmap, key, node);
+    // a child that is still live is shared, otherwise it is read back and becomes a memo entry of its own,
+    // so every node in memory is charged to the budget once and never read back twice
+    MemoClaim claim;
+    WordleNode *node = solver_hashmap_claim(memo_spill_key(offset), &claim);
+    return node != NULL ? node : fault_node(&claim, offset);
 }
 
-void free_node(WordleNode *node)
+WordleNode *fault_node(MemoClaim *claim, size_t offset)
 {
-    if (node == NULL)
+    // the subset is claimed and no stripe lock is held, children live in other stripes
+    WordleNode *node = memo_spill_load(offset);
+    for (size_t i = 0; i < node->num_branches; i++)
     {
-        return;
+        node->branches[i].node = resolve_spilled(memo_spill_child(offset, i));
     }
-    free(node->key);
-    free(node->branches);
-    free(node);
+    return solver_hashmap_put(claim, node);
+}
+
+WordleNode *solver_hashmap_claim(const hasmap_key_t *key, MemoClaim *claim)
+{
+    // a found node is retained before the lock is dropped, it could be evicted right after
+    MemoStripe *stripe = memo_stripe(key);
+    pthread_mutex_lock(&stripe->lock);
+    while (true)
+    {
+        WordleNode *node = find_node(stripe, key);
+        if (node != NULL)
+        {
+            retain_node(node);
+            pthread_mutex_unlock(&stripe->lock);
+            return node;
+        }
+        MemoClaim *other = stripe->claims;
+        while (other != NULL && compare(other->key, key) != 0)
+        {
+            other = other->next;
+        }
+        if (other == NULL)
+        {
+            break;
+        }
+        // the claiming thread only waits on smaller subsets itself, so this cannot form a cycle.
+        // a subset being read back is claimed as well, so it is only faulted in once
+        pthread_cond_wait(&stripe->released, &stripe->lock);
+    }
+    // a subset read back from the spill file is claimed as well, its children are resolved without the lock
+    claim->key = key;
+    claim->stripe = stripe;
+    claim->next = stripe->claims;
+    stripe->claims = claim;
+    size_t offset = stripe->n_spilled > 0 ? find_spilled(stripe, key) : 0;
+    pthread_mutex_unlock(&stripe->lock);
+    // the loaded reference goes to the caller
+    return offset != 0 ? fault_node(claim, offset) : NULL;
+}
+
+void release_claim(MemoClaim *claim)
+{
+    // caller holds the stripe lock
+    MemoClaim **link = &claim->stripe->claims;
+    while (*link != claim)
+    {
+        link = &(*link)->next;
+    }
+    *link = claim->next;
+    pthread_cond_broadcast(&claim->stripe->released);
+}
+
+WordleNode *solver_hashmap_put(MemoClaim *claim, WordleNode *node)
+{
+    // the node's key has to be set, the caller's reference is traded for the entry already stored, if any
+    MemoStripe *stripe = claim->stripe;
+    pthread_mutex_lock(&stripe->lock);
+    WordleNode *stored = store_node(stripe, node);
+    if (stored != node)
+    {
+        retain_node(stored);
+    }
+    release_claim(claim);
+    pthread_mutex_unlock(&stripe->lock);
+    if (stored != node)
+    {
+        release_node(node);
+    }
+    return stored;
+}
+
+void solver_hashmap_release(MemoClaim *claim)
+{
+    // the subset could not be solved within beta, a waiting thread may try again with its own
+    MemoStripe *stripe = claim->stripe;
+    pthread_mutex_lock(&stripe->lock);
+    release_claim(claim);
+    pthread_mutex_unlock(&stripe->lock);
 }
 
 void solver_hashmap_cleanup()
 {
-    WordleNode *node;
-    hashmap_foreach_data(node, &solver_hashmap)
+    // the nodes themselves are freed all at once by arena_reset()
+    for (size_t i = 0; i < MEMO_STRIPES; i++)
     {
-        free_node(node);
+        MemoStripe *stripe = &solver_hashmap[i];
+        free(stripe->buckets);
+        free(stripe->spill_slots);
+        pthread_cond_destroy(&stripe->released);
+        pthread_mutex_destroy(&stripe->lock);
     }
-    hashmap_cleanup(&solver_hashmap);
-}
\ No newline at end of file
+    print_memo_spill_usage();
+    memo_spill_close();
+}
@@ -1,13 +1,41 @@
 #pragma once
 
 #include "solver_utility.h"
-#include <hashmap.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
 #define KEY_SIZE 2315
+// bitset words of a key, subsets up to KEY_LIST_MAX words are stored as a sorted index list of at most that size
+#define KEY_WORDS ((KEY_SIZE + 63) / 64)
+#define KEY_LIST_MAX (KEY_WORDS * 4)
+// hard mode keys also hold the allowed test words, likewise as a sorted index list or a bitset
+#define TEST_KEY_SIZE 12972
+#define TEST_KEY_WORDS ((TEST_KEY_SIZE + 63) / 64)
+#define TEST_KEY_LIST_MAX (TEST_KEY_WORDS * 4)
+// independently locked parts of the memo
+#define MEMO_STRIPES 64
+#define MEMO_BUCKET_SLOTS 4
+// a normal mode solve stores about n_hidden^2 / 25 nodes, hard mode grows from there
+#define MEMO_EXPECTED_ENTRIES(n_hidden) ((n_hidden) * (n_hidden) / 25)
+// entries compared per eviction, the one that is cheapest to recompute goes
+#define MEMO_EVICTION_SAMPLES 8
+// seconds charged per hidden word on top of the measured duration, small subsets finish below the clock resolution
+#define MEMO_HIDDEN_COST 1e-6
 
-typedef bool hasmap_key_t[KEY_SIZE];
+typedef struct hasmap_key_t
+{
+    // hash of the subset and in hard mode of the allowed test words, rejects almost all unequal keys on its own
+    uint64_t fingerprint;
+    size_t n_hidden;
+    // allowed test words, 0 in normal mode where every subset is solved with all of them
+    size_t n_test;
+    // lookup keys carry the subset and test words themselves instead of a payload
+    const index_t *hidden_vector;
+    const index_t *test_vector;
+    // index_t list if n_hidden <= KEY_LIST_MAX, bitset otherwise, then the test words in the same way
+    uint64_t words[];
+} hasmap_key_t;
 
 typedef struct WordleBranch
 {
@@ -17,7 +45,7 @@ typedef struct WordleBranch
 
 typedef struct WordleNode
 {
-    size_t test_index;
+    index_t test_index;
     size_t num_branches;
     struct WordleBranch *branches;
     // stats
@@ -30,14 +58,42 @@ typedef struct WordleNode
     float average_case;
     // hashmap key
     hasmap_key_t *key;
+    // the memo and every parent branch hold a reference, nodes are freed with the last one
+    atomic_size_t refs;
+    // record of the node in the memo spill log, 0 if it was never written
+    size_t spill_offset;
 } WordleNode;
 
-void solver_hashmap_init();
+// marks a subset as being solved by one thread, lives on that thread's stack
+typedef struct MemoClaim
+{
+    const hasmap_key_t *key;
+    struct MemoStripe *stripe;
+    struct MemoClaim *next;
+} MemoClaim;
+
+size_t key_words(size_t n_hidden);
+
+size_t key_size(const hasmap_key_t *key);
+
+WordleNode *retain_node(WordleNode *node);
+
+void release_node(WordleNode *node);
+
+void release_branches(WordleBranch *branches, size_t num_branches);
+
+// budget in bytes for the nodes held by the memo, 0 never evicts
+// evicted nodes go to the spill file if there is one and are read back on the next hit
+void solver_hashmap_init(size_t expected_entries, size_t budget, const char *spill_file);
+
+void init_lookup_key(hasmap_key_t *key, const WordleSolverInstance *solver_instance);
+
+hasmap_key_t *get_key(const hasmap_key_t *lookup_key);
 
-hasmap_key_t *get_key(const WordleSolverInstance *solver_instance);
+WordleNode *solver_hashmap_claim(const hasmap_key_t *key, MemoClaim *claim);
 
-WordleNode *solver_hashmap_get(const hasmap_key_t *key);
+WordleNode *solver_hashmap_put(MemoClaim *claim, WordleNode *node);
 
-void solver_hashmap_put(const hasmap_key_t *key, WordleNode *node);
+void solver_hashmap_release(MemoClaim *claim);
 
 void solver_hashmap_cleanup();
@@ -2,61 +2,533 @@
 #include <math.h>
 #include <string.h>
 
-int compare_tuples(const void *a, const void *b)
+int compare_ranked_tuples(const tuple *a, const tuple *b)
 {
-    // descending order
-    tuple arg1 = *(const tuple *)a;
-    tuple arg2 = *(const tuple *)b;
-
-    if (arg1.value < arg2.value)
+    // descending, ties go to the lower test index so that the ranking does not depend on the current order
+    if (a->value < b->value)
+        return 1;
+    if (a->value > b->value)
+        return -1;
+    if (a->index > b->index)
         return 1;
-    if (arg1.value > arg2.value)
+    if (a->index < b->index)
         return -1;
     return 0;
 }
 
-double unnormalized_entropy(const size_t *branch_sizes, const size_t n_hidden)
+void sift_down(tuple *heap, size_t count, size_t i)
 {
-    double result = 0;
-    for (size_t i = 0; i < N_BRANCHES; i++)
+    // heap with the worst tuple on top
+    while (true)
     {
-        double branch_size = branch_sizes[i];
-        if (branch_size > 0)
+        size_t worst = i;
+        for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < count; child++)
+        {
+            if (compare_ranked_tuples(&heap[child], &heap[worst]) > 0)
+            {
+                worst = child;
+            }
+        }
+        if (worst == i)
         {
-            result += branch_size * log2(n_hidden / branch_size);
+            return;
         }
+        tuple tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
     }
-    return result;
 }
 
-bool sort_test_vector(const WordleSolverInstance *solver_instance, size_t *pruned_index)
+void select_top_tests(index_t *test_vector, double *test_values, size_t count, size_t k)
 {
-    size_t pruned_index_non_hidden = UINTMAX_MAX;
+    if (k > count)
+    {
+        k = count;
+    }
+    if (k == 0)
+    {
+        return;
+    }
+    // keep the k best test words in a heap
+    tuple top[k];
+    for (size_t i = 0; i < k; i++)
+    {
+        top[i] = (tuple){test_vector[i], test_values[i]};
+    }
+    for (size_t i = k / 2; i-- > 0;)
+    {
+        sift_down(top, k, i);
+    }
+    for (size_t i = k; i < count; i++)
+    {
+        tuple test = {test_vector[i], test_values[i]};
+        if (compare_ranked_tuples(&test, &top[0]) < 0)
+        {
+            top[0] = test;
+            sift_down(top, k, 0);
+        }
+    }
+    // move the remaining test words behind the first k in their current order, the worst selected one splits them exactly
+    tuple threshold = top[0];
+    size_t end = count;
+    for (size_t i = count; i-- > 0;)
+    {
+        tuple test = {test_vector[i], test_values[i]};
+        if (compare_ranked_tuples(&test, &threshold) > 0)
+        {
+            end--;
+            test_vector[end] = test.index;
+            test_values[end] = test.value;
+        }
+    }
+    // heap sort the selected tuples into descending order
+    for (size_t n = k; n-- > 1;)
+    {
+        tuple tmp = top[0];
+        top[0] = top[n];
+        top[n] = tmp;
+        sift_down(top, n, 0);
+    }
+    for (size_t i = 0; i < k; i++)
+    {
+        test_vector[i] = top[i].index;
+        test_values[i] = top[i].value;
+    }
+}
+
+// n * log2(n) in 32.32 fixed point, integer sums make equal partitions rank exactly equal
+uint64_t *nlogn_table = NULL;
+
+void init_entropy_table(size_t n_hidden)
+{
+    nlogn_table = malloc((n_hidden + 1) * sizeof(*nlogn_table));
+    nlogn_table[0] = 0;
+    for (size_t n = 1; n <= n_hidden; n++)
+    {
+        nlogn_table[n] = llround(n * log2(n) * ENTROPY_SCALE);
+    }
+}
+
+void free_entropy_table()
+{
+    free(nlogn_table);
+    nlogn_table = NULL;
+}
+
+FilterIndex filter_index = {0};
+
+void init_filter_index(const WordleInstance *wordle_instance)
+{
+    size_t n_words = (wordle_instance->n_test + 63) / 64;
+    filter_index.n_words = n_words;
+    filter_index.at = calloc(5 * 26 * n_words, sizeof(uint64_t));
+    filter_index.at_least = calloc(26 * 5 * n_words, sizeof(uint64_t));
+    for (size_t i = 0; i < wordle_instance->n_test; i++)
+    {
+        const char *test_word = wordle_instance->test_words[i];
+        uint8_t counts[26] = {0};
+        for (size_t p = 0; p < 5; p++)
+        {
+            size_t letter = test_word[p] - 'a';
+            filter_index.at[(p * 26 + letter) * n_words + i / 64] |= 1LU << (i % 64);
+            filter_index.at_least[(letter * 5 + counts[letter]++) * n_words + i / 64] |= 1LU << (i % 64);
+        }
+    }
+}
+
+void free_filter_index()
+{
+    free(filter_index.at);
+    free(filter_index.at_least);
+    filter_index = (FilterIndex){0};
+}
+
+// random value per hidden word, subsets are identified by the sum over their words
+uint64_t *fingerprint_table = NULL;
+// same for the test words, follows the hidden words in one allocation
+uint64_t *test_fingerprint_table = NULL;
+
+void init_fingerprint_table(size_t n_hidden, size_t n_test)
+{
+    // splitmix64 with a fixed seed, fingerprints are the same in every run
+    fingerprint_table = malloc((n_hidden + n_test) * sizeof(*fingerprint_table));
+    test_fingerprint_table = fingerprint_table + n_hidden;
+    uint64_t state = 0;
+    for (size_t i = 0; i < n_hidden + n_test; i++)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15LU);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9LU;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebLU;
+        fingerprint_table[i] = z ^ (z >> 31);
+    }
+}
+
+void free_fingerprint_table()
+{
+    free(fingerprint_table);
+    fingerprint_table = NULL;
+    test_fingerprint_table = NULL;
+}
+
+uint64_t subset_fingerprint(const index_t *hidden_vector, size_t n_hidden)
+{
+    uint64_t fingerprint = 0;
+    for (size_t i = 0; i < n_hidden; i++)
+    {
+        fingerprint += fingerprint_table[hidden_vector[i]];
+    }
+    return fingerprint;
+}
+
+uint64_t test_set_fingerprint(const index_t *test_vector, size_t n_test)
+{
+    uint64_t fingerprint = 0;
+    for (size_t i = 0; i < n_test; i++)
+    {
+        fingerprint += test_fingerprint_table[test_vector[i]];
+    }
+    return fingerprint;
+}
+
+double unnormalized_entropy(const uint8_t *scores, const size_t n_hidden, uint16_t (*histograms)[N_BRANCHES],
+                            size_t *n_branches, bool *solves)
+{
+    // sum_b b * log2(n / b) = n * log2(n) - sum_b b * log2(b)
+    uint64_t sum = 0;
+    size_t branches = 0;
+    if (n_hidden <= SPARSE_ENTROPY_MAX_HIDDEN)
+    {
+        // few hidden words: visit only the non-empty buckets and clear them on the way
+        uint16_t *histogram = histograms[0];
+        for (size_t j = 0; j < n_hidden; j++)
+        {
+            histogram[scores[j]]++;
+        }
+        *solves = histogram[N_BRANCHES - 1] > 0;
+        for (size_t j = 0; j < n_hidden; j++)
+        {
+            uint16_t size = histogram[scores[j]];
+            if (size > 0)
+            {
+                sum += nlogn_table[size];
+                branches++;
+                histogram[scores[j]] = 0;
+            }
+        }
+    }
+    else
+    {
+        // independent sub-histograms avoid store-to-load stalls on repeated scores
+        size_t j = 0;
+        for (; j + N_HISTOGRAMS <= n_hidden; j += N_HISTOGRAMS)
+        {
+            for (size_t k = 0; k < N_HISTOGRAMS; k++)
+            {
+                histograms[k][scores[j + k]]++;
+            }
+        }
+        for (; j < n_hidden; j++)
+        {
+            histograms[0][scores[j]]++;
+        }
+        *solves = false;
+        for (size_t k = 0; k < N_HISTOGRAMS; k++)
+        {
+            *solves |= histograms[k][N_BRANCHES - 1] > 0;
+        }
+        for (size_t b = 0; b < N_BRANCHES; b++)
+        {
+            uint16_t size = 0;
+            for (size_t k = 0; k < N_HISTOGRAMS; k++)
+            {
+                size += histograms[k][b];
+                histograms[k][b] = 0;
+            }
+            if (size > 0)
+            {
+                sum += nlogn_table[size];
+                branches++;
+            }
+        }
+    }
+    *n_branches = branches;
+    return (double)(nlogn_table[n_hidden] - sum) / ENTROPY_SCALE;
+}
+
+void init_partition_table(PartitionTable *table, size_t n_test)
+{
+    table->capacity = 1;
+    while (table->capacity < 2 * n_test)
+    {
+        table->capacity *= 2;
+    }
+    table->generation = 0;
+    table->generations = calloc(table->capacity, sizeof(*table->generations));
+    table->positions = malloc(table->capacity * sizeof(*table->positions));
+    table->hashes = malloc(table->capacity * sizeof(*table->hashes));
+}
+
+void free_partition_table(PartitionTable *table)
+{
+    free(table->generations);
+    free(table->positions);
+    free(table->hashes);
+}
+
+uint64_t partition_hash(const uint8_t *scores, const size_t n_hidden, uint8_t *labels)
+{
+    // label buckets by first occurrence so that relabelled partitions hash equal,
+    // the solved bucket keeps its own label as it changes the cost of the split
+    uint64_t hash = 0xcbf29ce484222325LU;
+    uint8_t next_label = 1;
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+        uint8_t score = scores[j];
+        if (score != N_BRANCHES - 1 && labels[score] == 0)
+        {
+            labels[score] = next_label++;
+        }
+        uint8_t label = score == N_BRANCHES - 1 ? UINT8_MAX : labels[score];
+        hash = (hash ^ label) * 0x100000001b3LU;
+    }
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+        labels[scores[j]] = 0;
+    }
+    return hash;
+}
+
+bool same_partition(const uint8_t *a, const uint8_t *b, const size_t n_hidden, uint8_t *a_to_b, uint8_t *b_to_a)
+{
+    // a partition equals another if the bucket labels map one to one, the solved bucket maps to itself.
+    // the maps hold label + 1 and are cleared again before returning.
+    bool same = true;
+    size_t j = 0;
+    for (; j < n_hidden; j++)
+    {
+        if ((a[j] == N_BRANCHES - 1) != (b[j] == N_BRANCHES - 1))
+        {
+            same = false;
+            break;
+        }
+        if (a_to_b[a[j]] == 0 && b_to_a[b[j]] == 0)
+        {
+            a_to_b[a[j]] = b[j] + 1;
+            b_to_a[b[j]] = a[j] + 1;
+        }
+        else if (a_to_b[a[j]] != b[j] + 1 || b_to_a[b[j]] != a[j] + 1)
+        {
+            same = false;
+            break;
+        }
+    }
+    for (size_t k = 0; k <= j && k < n_hidden; k++)
+    {
+        a_to_b[a[k]] = 0;
+        b_to_a[b[k]] = 0;
+    }
+    return same;
+}
+
+size_t compress_test_vector(const WordleSolverInstance *solver_instance)
+{
+    // letters that occur in no hidden word always score black, so test words that only differ in such
+    // letters split every subset of the hidden words the same way, also under hard mode constraints
+    uint32_t live_letters = 0;
+    for (size_t j = 0; j < solver_instance->n_hidden; j++)
+    {
+        const char *hidden_word = solver_instance->wordle_instance->hidden_words[solver_instance->hidden_vector[j]];
+        for (size_t k = 0; k < 5; k++)
+        {
+            live_letters |= 1U << (hidden_word[k] - 'a');
+        }
+    }
+    if (live_letters == (1U << 26) - 1)
+    {
+        return solver_instance->n_test;
+    }
+
+    // move one representative per relevance class to the front, the lowest test index (hidden words first)
+    PartitionTable *table = solver_instance->partition_table;
+    if (++table->generation == 0)
+    {
+        memset(table->generations, 0, table->capacity * sizeof(*table->generations));
+        table->generation = 1;
+    }
+    index_t *test_vector = solver_instance->test_vector;
+    size_t n_classes = 0;
     for (size_t i = 0; i < solver_instance->n_test; i++)
     {
-        bool prune = true;
-        size_t branch_sizes[N_BRANCHES] = {0};
-        for (size_t j = 0; j < solver_instance->n_hidden; j++)
+        const char *test_word = solver_instance->wordle_instance->test_words[test_vector[i]];
+        uint64_t relevance_class = 0;
+        for (size_t k = 0; k < 5; k++)
+        {
+            uint32_t letter = test_word[k] - 'a';
+            relevance_class = 27 * relevance_class + (((live_letters >> letter) & 1) ? letter + 1 : 0);
+        }
+        size_t slot = ((relevance_class * 0x9e3779b97f4a7c15LU) >> 32) & (table->capacity - 1);
+        while (table->generations[slot] == table->generation && table->hashes[slot] != relevance_class)
+        {
+            slot = (slot + 1) & (table->capacity - 1);
+        }
+        if (table->generations[slot] == table->generation)
+        {
+            index_t *representative = &test_vector[table->positions[slot]];
+            if (test_vector[i] < *representative)
+            {
+                index_t swap = *representative;
+                *representative = test_vector[i];
+                test_vector[i] = swap;
+            }
+            continue;
+        }
+        table->generations[slot] = table->generation;
+        table->hashes[slot] = relevance_class;
+        table->positions[slot] = n_classes;
+        index_t swap = test_vector[n_classes];
+        test_vector[n_classes] = test_vector[i];
+        test_vector[i] = swap;
+        n_classes++;
+    }
+    return n_classes;
+}
+
+const uint8_t *source_row(const WordleSolverInstance *solver_instance, size_t test_index)
+{
+    if (solver_instance->parent_scores != NULL)
+    {
+        return solver_instance->parent_scores + test_index * solver_instance->parent_n_hidden;
+    }
+    return score_cache_row(solver_instance->score_cache, test_index);
+}
+
+index_t *find_partition(const WordleSolverInstance *solver_instance, const uint8_t *scores, size_t position,
+                        uint8_t (*labels)[N_BRANCHES], uint8_t *gathered)
+{
+    // returns the representative of an equal partition, or records this test word as a new one
+    PartitionTable *table = solver_instance->partition_table;
+    const size_t n_hidden = solver_instance->n_hidden;
+    uint64_t hash = partition_hash(scores, n_hidden, labels[0]);
+    size_t slot = hash & (table->capacity - 1);
+    for (; table->generations[slot] == table->generation; slot = (slot + 1) & (table->capacity - 1))
+    {
+        if (table->hashes[slot] != hash)
         {
-            size_t score = solver_instance->score_cache[solver_instance->test_vector[i].index][solver_instance->hidden_vector[j]];
-            branch_sizes[score] += 1;
-            prune &= branch_sizes[score] == 1;
+            continue;
         }
-        if (prune)
+        index_t *representative = &solver_instance->test_vector[table->positions[slot]];
+        const uint8_t *representative_scores;
+        if (solver_instance->packed_scores != NULL)
         {
-            if (branch_sizes[N_BRANCHES - 1] == 1)
+            representative_scores = solver_instance->packed_scores + *representative * n_hidden;
+        }
+        else
+        {
+            const uint8_t *row = source_row(solver_instance, *representative);
+            for (size_t j = 0; j < n_hidden; j++)
             {
-                // directly prune on hidden word
-                *pruned_index = solver_instance->test_vector[i].index;
-                return prune;
+                gathered[j] = row[solver_instance->columns[j]];
             }
-            else
+            representative_scores = gathered;
+        }
+        if (same_partition(scores, representative_scores, n_hidden, labels[0], labels[1]))
+        {
+            return representative;
+        }
+    }
+    table->generations[slot] = table->generation;
+    table->hashes[slot] = hash;
+    table->positions[slot] = position;
+    return NULL;
+}
+
+const uint8_t *gather_scores(const WordleSolverInstance *solver_instance, size_t test_index, uint8_t *gathered)
+{
+    // gather the row, packing it into this node's tile if there is one
+    const uint8_t *row = source_row(solver_instance, test_index);
+    uint8_t *scores = gathered;
+    if (solver_instance->packed_scores != NULL)
+    {
+        scores = solver_instance->packed_scores + test_index * solver_instance->n_hidden;
+    }
+    for (size_t j = 0; j < solver_instance->n_hidden; j++)
+    {
+        scores[j] = row[solver_instance->columns[j]];
+    }
+    return scores;
+}
+
+bool sort_test_vector(const WordleSolverInstance *solver_instance, size_t *pruned_index)
+{
+    const size_t n_hidden = solver_instance->n_hidden;
+    uint16_t histograms[N_HISTOGRAMS][N_BRANCHES] = {0};
+    uint8_t gathered[n_hidden];
+    size_t n_branches;
+    bool solves;
+
+    // only a hidden word can split the hidden words into single words including its own, try those first.
+    // they are always valid guesses, as they are consistent with every score seen so far.
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+        size_t test_index = solver_instance->hidden_vector[j];
+        if (test_index >= solver_instance->wordle_instance->n_test)
+        {
+            continue;
+        }
+        const uint8_t *scores = gather_scores(solver_instance, test_index, gathered);
+        unnormalized_entropy(scores, n_hidden, histograms, &n_branches, &solves);
+        if (n_branches == n_hidden)
+        {
+            // directly prune on hidden word
+            *pruned_index = test_index;
+            return true;
+        }
+    }
+
+    // in normal mode guesses that split the hidden words the same way lead to the same subtrees,
+    // keep one representative per partition and rank the others last
+    PartitionTable *table = solver_instance->partition_table;
+    bool deduplicate = !solver_instance->wordle_instance->hard_mode;
+    if (deduplicate && ++table->generation == 0)
+    {
+        memset(table->generations, 0, table->capacity * sizeof(*table->generations));
+        table->generation = 1;
+    }
+    uint8_t labels[2][N_BRANCHES] = {0};
+    uint8_t representative_gathered[n_hidden];
+
+    size_t pruned_index_non_hidden = UINTMAX_MAX;
+    double max_entropy = 0;
+    for (size_t i = 0; i < solver_instance->n_test; i++)
+    {
+        size_t test_index = solver_instance->test_vector[i];
+        const uint8_t *scores = gather_scores(solver_instance, test_index, gathered);
+        double entropy = unnormalized_entropy(scores, n_hidden, histograms, &n_branches, &solves);
+        if (n_branches == n_hidden && test_index < pruned_index_non_hidden)
+        {
+            // maybe prune on non hidden word later
+            pruned_index_non_hidden = test_index;
+        }
+        solver_instance->test_values[i] = entropy;
+        max_entropy = entropy > max_entropy ? entropy : max_entropy;
+
+        // words below the entropy cutoff of the best word so far are never tested, skip hashing them
+        if (!deduplicate || entropy < SEARCH_ENTROPY_DEPTH * max_entropy)
+        {
+            continue;
+        }
+        index_t *representative = find_partition(solver_instance, scores, i, labels, representative_gathered);
+        if (representative != NULL)
+        {
+            solver_instance->test_values[i] = -INFINITY;
+            // keep the lowest test index as representative, hidden words come first and may be the solution
+            if (test_index < *representative)
             {
-                // maybe prune on non hidden word later
-                pruned_index_non_hidden = solver_instance->test_vector[i].index;
+                solver_instance->test_vector[i] = *representative;
+                *representative = test_index;
             }
         }
-        solver_instance->test_vector[i].value = unnormalized_entropy(branch_sizes, solver_instance->n_hidden);
     }
 
     if (pruned_index_non_hidden != UINTMAX_MAX)
@@ -65,41 +537,97 @@ bool sort_test_vector(const WordleSolverInstance *solver_instance, size_t *prune
         return true;
     }
 
-    qsort(solver_instance->test_vector, solver_instance->n_test, sizeof(tuple), compare_tuples);
+    // only the best SEARCH_DEPTH candidates are ever tested, the remaining order is unspecified
+    select_top_tests(solver_instance->test_vector, solver_instance->test_values, solver_instance->n_test, SEARCH_DEPTH);
     return false;
 }
 
 void create_branches(const WordleSolverInstance *solver_instance, Branch *branch)
 {
-    size_t test_index = branch->test_index;
-    memset(branch->sizes, 0, sizeof(branch->sizes));
-    branch->count = 0;
-    // count branch sizes
-    for (size_t j = 0; j < solver_instance->n_hidden; j++)
+    const size_t n_hidden = solver_instance->n_hidden;
+    const uint8_t *scores;
+    uint8_t gathered[n_hidden];
+    if (solver_instance->packed_scores != NULL)
     {
-        size_t score = solver_instance->score_cache[test_index][solver_instance->hidden_vector[j]];
-        branch->sizes[score].index = score;
-        branch->sizes[score].value++;
+        scores = solver_instance->packed_scores + branch->test_index * n_hidden;
     }
-    // set branch starts
-    for (size_t j = 1; j < N_BRANCHES; j++)
+    else
     {
-        branch->starts[j] = branch->starts[j - 1] + branch->sizes[j - 1].value;
+        const uint8_t *row = source_row(solver_instance, branch->test_index);
+        for (size_t j = 0; j < n_hidden; j++)
+        {
+            gathered[j] = row[solver_instance->columns[j]];
+        }
+        scores = gathered;
     }
-    // write partitioned indices
-    for (size_t j = 0; j < solver_instance->n_hidden; j++)
+    // count bucket sizes and note which scores occur, only those are visited afterwards
+    uint64_t seen[(N_BRANCHES + 63) / 64] = {0};
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+        branch->counts[scores[j]]++;
+        seen[scores[j] / 64] |= 1LU << (scores[j] % 64);
+    }
+    branch->solved = branch->counts[N_BRANCHES - 1];
+    branch->counts[N_BRANCHES - 1] = 0;
+    seen[(N_BRANCHES - 1) / 64] &= ~(1LU << ((N_BRANCHES - 1) % 64));
+    // counting sort of the buckets by descending size, scores are visited in ascending order so ties keep it
+    Bucket unsorted[N_BRANCHES - 1];
+    size_t count = 0;
+    size_t max_size = 0;
+    for (size_t w = 0; w < (N_BRANCHES + 63) / 64; w++)
+    {
+        for (uint64_t bits = seen[w]; bits != 0; bits &= bits - 1)
+        {
+            size_t score = 64 * w + __builtin_ctzll(bits);
+            unsorted[count++] = (Bucket){.score = score, .size = branch->counts[score]};
+            max_size = branch->counts[score] > max_size ? branch->counts[score] : max_size;
+        }
+    }
+    uint16_t positions[max_size + 1];
+    memset(positions, 0, sizeof(positions));
+    for (size_t i = 0; i < count; i++)
+    {
+        positions[unsorted[i].size]++;
+    }
+    for (size_t size = max_size, position = 0; size > 0; size--)
     {
-        size_t score = solver_instance->score_cache[test_index][solver_instance->hidden_vector[j]];
-        branch->hidden_indicies[branch->starts[score]] = solver_instance->hidden_vector[j];
-        branch->starts[score]++;
+        size_t n = positions[size];
+        positions[size] = position;
+        position += n;
     }
-    // correct branch starts & count nonzero branches
-    for (size_t j = 0; j < N_BRANCHES; j++)
+    // buckets lie one after another in that order, counts turn into the next free slot of each score
+    for (size_t i = 0; i < count; i++)
     {
-        branch->starts[j] -= branch->sizes[j].value;
-        if (branch->sizes[j].value > 0 && j != N_BRANCHES - 1) // ignore GGGGG (242)
+        branch->buckets[positions[unsorted[i].size]++] = unsorted[i];
+    }
+    // position of each score's bucket, so a word's fingerprint goes to its bucket as it is written
+    uint8_t bucket_of[N_BRANCHES];
+    for (size_t i = 0, start = 0; i < count; i++)
+    {
+        branch->buckets[i].start = start;
+        branch->buckets[i].fingerprint = 0;
+        branch->counts[branch->buckets[i].score] = start;
+        bucket_of[branch->buckets[i].score] = i;
+        start += branch->buckets[i].size;
+    }
+    branch->count = count;
+    // write partitioned indices and their columns in this node's tile and sum up the children's fingerprints,
+    // the solved words have no child
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+        if (scores[j] == N_BRANCHES - 1)
         {
-            branch->count++;
+            continue;
         }
+        size_t slot = branch->counts[scores[j]]++;
+        index_t hidden_index = solver_instance->hidden_vector[j];
+        branch->hidden_indicies[slot] = hidden_index;
+        branch->columns[slot] = j;
+        branch->buckets[bucket_of[scores[j]]].fingerprint += fingerprint_table[hidden_index];
+    }
+    // leave the counts cleared for the next partition
+    for (size_t i = 0; i < count; i++)
+    {
+        branch->counts[branch->buckets[i].score] = 0;
     }
 }
@@ -1,38 +1,129 @@
 #pragma once
+#include "score_cache.h"
 #include "wordle.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 #define N_BRANCHES 243
+#define MAX_DEPTH 10
+// number of best ranked test words tried per node
+#define SEARCH_DEPTH 50
+// test words below this fraction of the best entropy are not tried
+#define SEARCH_ENTROPY_DEPTH 0.75
+// nodes with at most this many hidden words pack their scores into a contiguous tile
+#define PACK_MAX_HIDDEN 128
+// ranking uses interleaved histograms, or a sparse walk over the scores for small nodes
+#define N_HISTOGRAMS 4
+#define SPARSE_ENTROPY_MAX_HIDDEN 96
+#define ENTROPY_SCALE 4294967296.0
+
+// word indices and bucket sizes, dictionaries stay far below 65536 words
+typedef uint16_t index_t;
 
 typedef struct tuple
 {
-    size_t index;
+    index_t index;
     double value;
 } tuple;
 
+// non-empty score bucket of a branching node, its words are hidden_indicies[start] onwards
+typedef struct Bucket
+{
+    uint8_t score;
+    uint16_t size;
+    uint16_t start;
+    uint64_t fingerprint;
+} Bucket;
+
+// open addressing map of partitions or relevance classes seen at one node, cleared by bumping the generation
+typedef struct PartitionTable
+{
+    size_t capacity;
+    uint32_t generation;
+    uint32_t *generations;
+    uint32_t *positions;
+    uint64_t *hashes;
+} PartitionTable;
+
 typedef struct WordleSolverInstance
 {
     const WordleInstance *wordle_instance;
     const size_t n_hidden;
-    const size_t *hidden_vector;
+    const index_t *hidden_vector;
     const size_t n_test;
-    tuple *test_vector;
-    const uint8_t **score_cache;
+    index_t *test_vector;
+    // entropy of test_vector[i], written by sort_test_vector into a buffer of the worker
+    double *test_values;
+    ScoreCache *score_cache;
+    // the score of hidden_vector[j] is row[columns[j]], where rows come from the parent tile
+    // (parent_scores[test_index * parent_n_hidden]) or from the score cache if there is none
+    const uint8_t *parent_scores;
+    const size_t parent_n_hidden;
+    const index_t *columns;
+    // tile of this node, packed_scores[test_index * n_hidden + j], filled by sort_test_vector
+    uint8_t *packed_scores;
+    PartitionTable *partition_table;
+    // sum of the fingerprint_table entries of the hidden words, identifies the subset in the memo
+    const uint64_t fingerprint;
+    // bitset of the allowed test words, hard mode only and set for nodes that branch
+    const uint64_t *test_set;
     const size_t depth;
 } WordleSolverInstance;
 
+// bitsets over all test words, the hard mode filter only combines them
+typedef struct FilterIndex
+{
+    size_t n_words;
+    // words with letter l at position p: at[(p * 26 + l) * n_words]
+    uint64_t *at;
+    // words with at least c + 1 copies of letter l: at_least[(l * 5 + c) * n_words]
+    uint64_t *at_least;
+} FilterIndex;
+
+extern FilterIndex filter_index;
+
 typedef struct Branch
 {
-    size_t test_index;
+    index_t test_index;
+    // non-empty buckets without the solved one (GGGGG), largest first and ties by score
     size_t count;
-    tuple sizes[N_BRANCHES];
-    size_t starts[N_BRANCHES];
-    size_t *hidden_indicies;
+    Bucket buckets[N_BRANCHES - 1];
+    // hidden words the test word itself solves
+    size_t solved;
+    // bucket sizes by score while partitioning, all zero in between
+    uint16_t counts[N_BRANCHES];
+    index_t *hidden_indicies;
+    // column of each partitioned hidden word in the tile of the branching node
+    index_t *columns;
 } Branch;
 
+void init_partition_table(PartitionTable *table, size_t n_test);
+
+void free_partition_table(PartitionTable *table);
+
+void init_entropy_table(size_t n_hidden);
+
+void free_entropy_table();
+
+void init_filter_index(const WordleInstance *wordle_instance);
+
+void free_filter_index();
+
+void init_fingerprint_table(size_t n_hidden, size_t n_test);
+
+void free_fingerprint_table();
+
+uint64_t subset_fingerprint(const index_t *hidden_vector, size_t n_hidden);
+
+// order independent like subset_fingerprint, but over the test words
+uint64_t test_set_fingerprint(const index_t *test_vector, size_t n_test);
+
+size_t compress_test_vector(const WordleSolverInstance *solver_instance);
+
+const uint8_t *source_row(const WordleSolverInstance *solver_instance, size_t test_index);
+
 bool sort_test_vector(const WordleSolverInstance *solver_instance, size_t *pruned_index);
 
 void create_branches(const WordleSolverInstance *solver_instance, Branch *branch);
 
-int compare_tuples(const void *a, const void *b);
+void select_top_tests(index_t *test_vector, double *test_values, size_t count, size_t k);
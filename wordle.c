@@ -1,6 +1,12 @@
 #include "wordle.h"
+#include <pthread.h>
 #include <stdbool.h>
 #include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCORE_KERNEL_X86
+#endif
 
 const uint8_t POWERS_OF_THREE[5] = {1, 3, 9, 27, 81};
 const char *WORDLE_EMOJIS[3] = {"⬛", "🟨", "🟩"};
@@ -53,11 +59,129 @@ uint8_t score(const char *test_word, const char *hidden_word)
     return result;
 }
 
-uint8_t **populate_score_cache(const WordleInstance *wordle_instance)
+// lane-parallel version of score(): every mask lane is 0x00 or 0xFF, one lane per hidden word
+#define DEFINE_SCORE_KERNEL(name, width, isa)                                                            \
+    typedef uint8_t name##_vector __attribute__((vector_size(width)));                                   \
+    __attribute__((target(isa)))   static void name(const char *test_word, const ScoreColumns *columns, \
+                                                     uint8_t *row)                                       \
+    {                                                                                                    \
+        name##_vector test[5];                                                                           \
+        for (uint8_t i = 0; i < 5; i++)                                                                  \
+        {                                                                                                \
+            test[i] = (name##_vector){0} + test_word[i];                                                 \
+        }                                                                                                \
+        for (size_t j = 0; j < columns->n_hidden; j += (width))                                          \
+        {                                                                                                \
+            name##_vector hidden[5], green[5], crossed[5];                                               \
+            name##_vector result = {0};                                                                  \
+            for (uint8_t i = 0; i < 5; i++)                                                              \
+            {                                                                                            \
+                memcpy(&hidden[i], columns->letters + i * columns->stride + j, (width));                 \
+                green[i] = (name##_vector)(test[i] == hidden[i]);                                        \
+                crossed[i] = green[i];                                                                   \
+                result += green[i] & (uint8_t)(2 * POWERS_OF_THREE[i]);                                  \
+            }                                                                                            \
+            for (uint8_t i = 0; i < 5; i++)                                                              \
+            {                                                                                            \
+                name##_vector found = green[i];                                                          \
+                for (uint8_t k = 0; k < 5; k++)                                                          \
+                {                                                                                        \
+                    name##_vector match = (name##_vector)(test[i] == hidden[k]) & ~crossed[k] & ~found;  \
+                    crossed[k] |= match;                                                                 \
+                    found |= match;                                                                      \
+                }                                                                                        \
+                result += found & ~green[i] & POWERS_OF_THREE[i];                                        \
+            }                                                                                            \
+            size_t n = columns->n_hidden - j < (width) ? columns->n_hidden - j : (width);                \
+            memcpy(row + j, &result, n);                                                                 \
+        }                                                                                                \
+    }
+
+#ifdef SCORE_KERNEL_X86
+DEFINE_SCORE_KERNEL(score_row_sse2, 16, "sse2")
+DEFINE_SCORE_KERNEL(score_row_avx2, 32, "avx2")
+#endif
+
+void score_row_scalar(const char *test_word, const ScoreColumns *columns, uint8_t *row)
 {
-    size_t rows = wordle_instance->n_test;
-    size_t cols = wordle_instance->n_hidden;
+    for (size_t j = 0; j < columns->n_hidden; j++)
+    {
+        char hidden_word[5];
+        for (uint8_t i = 0; i < 5; i++)
+        {
+            hidden_word[i] = columns->letters[i * columns->stride + j];
+        }
+        row[j] = score(test_word, hidden_word);
+    }
+}
 
+ScoreColumns transpose_hidden_words(const WordleInstance *wordle_instance)
+{
+    // pad columns so that the kernels never read past the end
+    size_t stride = (wordle_instance->n_hidden + SCORE_BATCH - 1) / SCORE_BATCH * SCORE_BATCH;
+    ScoreColumns columns = {
+        .n_hidden = wordle_instance->n_hidden,
+        .stride = stride,
+        .letters = calloc(5 * stride, sizeof(char)),
+    };
+    for (size_t j = 0; j < wordle_instance->n_hidden; j++)
+    {
+        for (uint8_t i = 0; i < 5; i++)
+        {
+            columns.letters[i * stride + j] = wordle_instance->hidden_words[j][i];
+        }
+    }
+    return columns;
+}
+
+void score_row(const char *test_word, const ScoreColumns *columns, uint8_t *row)
+{
+#ifdef SCORE_KERNEL_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        score_row_avx2(test_word, columns, row);
+        return;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        score_row_sse2(test_word, columns, row);
+        return;
+    }
+#endif
+    score_row_scalar(test_word, columns, row);
+}
+
+size_t resolve_threads(size_t n_threads)
+{
+    if (n_threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = online > 0 ? online : 1;
+    }
+    return n_threads;
+}
+
+typedef struct ScoreCacheWorker
+{
+    const WordleInstance *wordle_instance;
+    const ScoreColumns *columns;
+    uint8_t **score_cache;
+    size_t begin;
+    size_t end;
+} ScoreCacheWorker;
+
+void *populate_score_rows(void *arg)
+{
+    const ScoreCacheWorker *worker = arg;
+    for (size_t i = worker->begin; i < worker->end; i++)
+    {
+        score_row(worker->wordle_instance->test_words[i], worker->columns, worker->score_cache[i]);
+    }
+    return NULL;
+}
+
+uint8_t **allocate_score_cache(size_t rows, size_t cols)
+{
     uint8_t **score_cache = malloc(sizeof(uint8_t *) * rows + sizeof(uint8_t) * cols * rows);
 
     // ptr is now pointing to the first element in of 2D array
@@ -68,14 +192,52 @@ uint8_t **populate_score_cache(const WordleInstance *wordle_instance)
     {
         score_cache[i] = (ptr + cols * i);
     }
+    return score_cache;
+}
 
-    // populate cache
-    for (size_t i = 0; i < rows; i++)
+uint8_t **populate_score_cache(const WordleInstance *wordle_instance)
+{
+    size_t rows = wordle_instance->n_test;
+    uint8_t **score_cache = allocate_score_cache(rows, wordle_instance->n_hidden);
+
+    // populate cache, every worker fills a contiguous block of rows
+    ScoreColumns columns = transpose_hidden_words(wordle_instance);
+    size_t n_threads = resolve_threads(wordle_instance->n_threads);
+    if (n_threads > rows)
+    {
+        n_threads = rows > 0 ? rows : 1;
+    }
+    pthread_t threads[n_threads];
+    ScoreCacheWorker workers[n_threads];
+    for (size_t t = 0; t < n_threads; t++)
     {
-        for (size_t j = 0; j < cols; j++)
+        workers[t] = (ScoreCacheWorker){
+            .wordle_instance = wordle_instance,
+            .columns = &columns,
+            .score_cache = score_cache,
+            .begin = rows * t / n_threads,
+            .end = rows * (t + 1) / n_threads,
+        };
+    }
+    // the calling thread takes the first block itself
+    size_t started = 1;
+    for (; started < n_threads; started++)
+    {
+        if (pthread_create(&threads[started], NULL, populate_score_rows, &workers[started]) != 0)
         {
-            score_cache[i][j] = score(wordle_instance->test_words[i], wordle_instance->hidden_words[j]);
+            break;
         }
     }
+    populate_score_rows(&workers[0]);
+    for (size_t t = 1; t < started; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    // fall back to this thread for blocks whose worker could not be started
+    for (size_t t = started; t < n_threads; t++)
+    {
+        populate_score_rows(&workers[t]);
+    }
+    free(columns.letters);
     return score_cache;
 }
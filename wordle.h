@@ -11,10 +11,36 @@ typedef struct WordleInstance
     const size_t n_test;
     const char (*test_words)[6];
     const bool hard_mode;
+    // worker threads used by the solver, 0 uses every online core
+    const size_t n_threads;
+    // memory-mapped score matrix shared between runs, NULL disables it
+    const char *score_cache_file;
+    // bytes of solved subsets the memo may hold, 0 keeps every one of them
+    const size_t memo_budget;
+    // scratch file that evicted memo entries are spilled to, NULL drops them
+    const char *memo_spill_file;
 } WordleInstance;
 
+// number of hidden words scored at once by the widest kernel
+#define SCORE_BATCH 32
+
+typedef struct ScoreColumns
+{
+    size_t n_hidden;
+    size_t stride;
+    char *letters; // letters[position * stride + hidden_index]
+} ScoreColumns;
+
 void descore(uint8_t score, char *output);
 
 uint8_t score(const char *test_word, const char *hidden_word);
 
+size_t resolve_threads(size_t n_threads);
+
+ScoreColumns transpose_hidden_words(const WordleInstance *wordle_instance);
+
+void score_row(const char *test_word, const ScoreColumns *columns, uint8_t *row);
+
+uint8_t **allocate_score_cache(size_t rows, size_t cols);
+
 uint8_t **populate_score_cache(const WordleInstance *wordle_instance);